@@ -0,0 +1,47 @@
+/*
+ * File:   LayerSetCache.h
+ *
+ * Bounded, thread safe memoization of categorization results.
+ */
+#pragma once
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "LayerSetTypes.h"
+
+class LayerMap;
+
+// Type alias for a shared categorization result that must not be modified
+typedef std::shared_ptr<const LayerMap> LayerMapPtr;
+
+/**
+ * Least recently used cache of LayerMap results, keyed by a string describing the request.
+ * All methods can be called concurrently.
+ */
+class LayerMapCache {
+public:
+    explicit LayerMapCache(size_t capacity);
+    // returns the cached result for a key and marks it as recently used, or an empty pointer
+    LayerMapPtr find(const string&);
+    // stores a result, evicting the least recently used one when the cache is full
+    void insert(const string&, const LayerMapPtr&);
+    void clear();
+    size_t size() const;
+    size_t capacity() const;
+    // amount of find calls that returned a result
+    size_t hits() const;
+    // amount of find calls that returned an empty pointer
+    size_t misses() const;
+private:
+    typedef std::list<std::pair<string, LayerMapPtr> > EntryList;
+    // most recently used entries first
+    EntryList m_entries;
+    std::unordered_map<string, EntryList::iterator> m_lookup;
+    mutable std::mutex m_mutex;
+    size_t m_capacity;
+    std::atomic<size_t> m_hits;
+    std::atomic<size_t> m_misses;
+};
@@ -12,9 +12,59 @@
 //In the channels config files, these values will be used for topology functions
 static const string TOPOLOGY_KEY_LEXICAL = "topology";
 
-// simple function to load yaml or json from a file path to a YAML::Node object
-YAML::Node _loadConfigFromPath(const string&);
-// converts YAML::Node  data to a map of strings (StrMapType)
-StrMapType _categoryMapFromConfig(const YAML::Node&);
+// configuration files loaded from a directory, same as the python layer_alchemy._config.collapse
+static const string CONFIG_FILE_PATTERN = "*.y*ml";
+
+// yaml tag of a category removing its values from the configurations loaded before it, "diffuse: !remove {? albedo}"
+static const string REMOVE_TAG = "!remove";
+
+// the values of a category in one or more configuration files
+struct ConfigValues {
+    // values of the category, with the values of the sets it merges as they were in its file
+    StrVecType values;
+    // sorted names of the categories merged with "<<" merge keys, the category hierarchy
+    StrVecType merges;
+    // true for yaml sets (!!set), which are merged as a union, lists are appended instead
+    bool isSet;
+    // true for categories tagged REMOVE_TAG, their values are removed when merged
+    bool isRemoval;
+};
+// Type alias for storing category names and their values before the files are merged
+typedef map<string, ConfigValues> ConfigMapType;
+
+// moves the values of a ConfigMapType to a map of strings (StrMapType), removals have nothing to remove from
+StrMapType _categoryMapFromConfigMap(ConfigMapType&);
+// counts gathered while loading a configuration file, see ConfigTester
+struct ConfigLoadProfile {
+    // set entries and list items written in the file
+    size_t literalMembers;
+    // values brought to sets by "<<" merge keys, a set merging a set that merged another counts both merges
+    size_t mergedMembers;
+    // values found more than once in the same category, written twice or brought again by a merge
+    size_t duplicateMembers;
+};
+
+// loads a yaml or json file to a ConfigMapType from the parser events, without building a YAML::Node tree.
+// Sets copy the values of the sets they merge with "<<", and the names of the merged anchored categories are kept
+// in their merges. Errors are YAML::Exception with the position in the file. The profile is filled if given
+ConfigMapType _streamConfigFromPath(const string&, ConfigLoadProfile* profile = nullptr);
+// merges the values of a category in the ones it had, sets are unioned, lists appended and removals erase their values.
+// Merged categories are unioned, a removal un-nests the category : it forgets the categories it merged
+void _mergeConfigValues(ConfigValues&, const ConfigValues&);
+// merges a configuration in another, sets are unioned and lists appended.
+// Removals erase values, categories left empty by them are removed
+void _mergeConfigMap(ConfigMapType&, const ConfigMapType&);
+// loads several configuration files in parallel to a ConfigMapType, merged in the given order.
+// uses the compiled images of the files instead when they are up to date (see LayerSetConfigCache.h)
+ConfigMapType _loadConfigMaps(const StrVecType&);
+// loads a configuration file, or the files of a directory, to a ConfigMapType, like _loadConfigMaps
+ConfigMapType _loadConfigMap(const string&);
+// returns the sorted configuration file paths in a directory
+StrVecType configFilesInDirectory(const string&);
 // simple wrapper function to load a yaml or json file to a map of strings (StrMapType)
+// uses the compiled image of the file instead when it is up to date (see LayerSetConfigCache.h)
+// a directory loads all its configuration files, like loadConfigsToMap
 StrMapType loadConfigToMap(const string&);
+// loads several configuration files in parallel, and merges them in the given order.
+// merged sets are sorted, lists keep the order of the files
+StrMapType loadConfigsToMap(const StrVecType&);
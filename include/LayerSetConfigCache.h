@@ -0,0 +1,54 @@
+/*
+ * File:   LayerSetConfigCache.h
+ *
+ * Compiled binary images of configuration files, loaded with mmap instead of parsing yaml.
+ */
+#pragma once
+#include <cstdint>
+
+#include "LayerSetConfig.h"
+
+// appended to a configuration file path to get the path of its compiled image
+static const string CONFIG_CACHE_EXTENSION = ".cache";
+// bumped whenever the image layout changes, older images are then ignored
+static const uint32_t CONFIG_CACHE_VERSION = 2;
+
+/**
+ * Layout of a compiled configuration image, all integers are native endian :
+ *
+ *  ConfigCacheHeader
+ *  uint32_t stringOffsets[stringCount + 1]   offsets of each string in the character data
+ *  uint32_t categories[categoryCount * 6]    category name string id, CONFIG_CACHE_SET and CONFIG_CACHE_REMOVAL
+ *                                            flags, first member index, member count, first merge index, merge count
+ *  uint32_t members[memberCount]             member string ids, in configuration order
+ *  uint32_t merges[mergeCount]               string ids of the merged category names
+ *  char     characters[]                     null terminated strings
+ *
+ * The checksum covers everything after the header, and the source fields identify the yaml file
+ * the image was compiled from, so a modified configuration is detected as stale.
+ */
+struct ConfigCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t stringCount;
+    uint32_t categoryCount;
+    uint32_t memberCount;
+    uint32_t mergeCount;
+    uint64_t sourceSize;
+    uint64_t sourceChecksum;
+    uint64_t payloadSize;
+    uint64_t payloadChecksum;
+};
+
+// flags of a category in a compiled image
+static const uint32_t CONFIG_CACHE_SET = 1;
+static const uint32_t CONFIG_CACHE_REMOVAL = 2;
+
+// returns the default compiled image path of a configuration file
+string configCachePath(const string&);
+// writes the compiled image of a configuration map for a source configuration file, throws on failure
+void writeConfigCache(const ConfigMapType&, const string& sourcePath, const string& cachePath);
+// loads the configuration file and writes its compiled image, throws on failure
+void compileConfigCache(const string& sourcePath, const string& cachePath);
+// fills a configuration map from a compiled image, returns false if it is missing, invalid or stale
+bool loadConfigCache(const string& sourcePath, const string& cachePath, ConfigMapType&);
@@ -1,11 +1,21 @@
 #pragma once
+#include <iterator>
+#include <memory>
+#include <unordered_set>
 
 #include "LayerSetTypes.h"
 #include "LayerSetConfig.h"
+#include "LayerSetOverlay.h"
+#include "LayerSetIndex.h"
+#include "LayerSetCache.h"
+#include "LayerSetResult.h"
 
 #define LAYER_ENV_VAR "LAYER_ALCHEMY_LAYER_CONFIG"
 #define CHANNEL_ENV_VAR "LAYER_ALCHEMY_CHANNEL_CONFIG"
 
+// amount of categorization results kept by a LayerCollection
+static const size_t CATEGORIZE_CACHE_CAPACITY = 256;
+
 //Enumeration class to  qualify the type of categories to search for.
  enum class categorizeType {
     /**<b>"private" categories : </b>
@@ -41,46 +51,160 @@
 class CategorizeFilter {
 public:
     enum modes {
-        INCLUDE = 0, EXCLUDE, ONLY
+        INCLUDE = 0, EXCLUDE, ONLY, EXPRESSION
     };
     CategorizeFilter();
     CategorizeFilter(const StrVecType&, int);
+    // an EXPRESSION filter, keeping the layers matching a boolean expression of category names with
+    // "|", "&", "!" and parentheses, like "(beauty_shading | light_group) & !albedo".
+    // Throws std::invalid_argument for invalid expressions
+    explicit CategorizeFilter(const string& expression);
     int filterMode;
+    // for EXPRESSION, the category names of the expression
     StrVecType categories;
+    string expression;
+    // for EXPRESSION, the postfix instructions of the expression, OP_ANY indexes categories
+    vector<std::pair<FilterProgram::OpCode, size_t> > program;
+};
+
+/**
+ * Iterates over the category names of a StrMapType, skipping the ones of the other categorizeType
+ */
+class CategoryIterator {
+public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef const string value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const string* pointer;
+    typedef const string& reference;
+
+    CategoryIterator(StrMapType::const_iterator, StrMapType::const_iterator, categorizeType);
+    reference operator*() const {return m_current->first;}
+    pointer operator->() const {return &m_current->first;}
+    CategoryIterator& operator++();
+    CategoryIterator operator++(int);
+    bool operator==(const CategoryIterator& other) const {return m_current == other.m_current;}
+    bool operator!=(const CategoryIterator& other) const {return m_current != other.m_current;}
+private:
+    // moves forward until a category of the right type is found
+    void _skip();
+    StrMapType::const_iterator m_current;
+    StrMapType::const_iterator m_end;
+    categorizeType m_catType;
+};
+
+/**
+ * Iterates once over every layer name of a StrMapType, in category then member order.
+ * Copies of an iterator share the names already visited, so it is a single pass iterator.
+ */
+class UniqueLayerIterator {
+public:
+    typedef std::input_iterator_tag iterator_category;
+    typedef const string value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const string* pointer;
+    typedef const string& reference;
+
+    UniqueLayerIterator(StrMapType::const_iterator, StrMapType::const_iterator);
+    reference operator*() const {return m_category->second[m_member];}
+    pointer operator->() const {return &m_category->second[m_member];}
+    UniqueLayerIterator& operator++();
+    bool operator==(const UniqueLayerIterator& other) const;
+    bool operator!=(const UniqueLayerIterator& other) const {return !(*this == other);}
+private:
+    // hashes the pointed to string, not the pointer
+    struct NameHash {
+        size_t operator()(const string* name) const {return std::hash<string>()(*name);}
+    };
+    struct NameEqual {
+        bool operator()(const string* a, const string* b) const {return *a == *b;}
+    };
+    typedef std::unordered_set<const string*, NameHash, NameEqual> SeenType;
+    // moves forward until a layer name that was not visited is found
+    void _skip();
+    StrMapType::const_iterator m_category;
+    StrMapType::const_iterator m_end;
+    size_t m_member;
+    std::shared_ptr<SeenType> m_seen;
+};
+
+/**
+ * The unique layer names of a StrMapType, each begin() starts a new pass with its own visited names,
+ * so the view can be iterated, measured or tested for emptiness any number of times
+ */
+class UniqueLayersView {
+public:
+    UniqueLayersView(StrMapType::const_iterator first, StrMapType::const_iterator last) : m_first(first), m_last(last) {}
+    UniqueLayerIterator begin() const {return UniqueLayerIterator(m_first, m_last);}
+    UniqueLayerIterator end() const {return UniqueLayerIterator(m_last, m_last);}
+    bool empty() const {return begin() == end();}
+    size_t size() const {return std::distance(begin(), end());}
+private:
+    StrMapType::const_iterator m_first;
+    StrMapType::const_iterator m_last;
 };
 
 /**
  * Base class for manipulating mappings.
+ *
+ * Alongside the category mapping, the members of each category are kept in a sorted flat set so
+ * membership tests are logarithmic. The mapping is only modified through add(), remove() and set(),
+ * which keep both in sync. It replaces the former public strMap member, read it with strMap().
  */
 class LayerMap {
+private:
+    // category names and their layers, in insertion order
+    StrMapType m_strMap;
+    // sorted unique members of each category
+    map<string, StrVecType> m_sortedMembers;
+    // sorts and stores the members of a category
+    void _indexCategory(const string&, const StrVecType&);
+    // rebuilds the sorted members of every category
+    void _reindex();
+
 public:
-    //data stored publicly, for now.
-    StrMapType strMap;
     LayerMap();
-    LayerMap(const LayerMap&);
+    LayerMap(const LayerMap&) = default;
+    LayerMap(LayerMap&&) = default;
     LayerMap(const StrMapType&);
     LayerMap(const string&);
     virtual ~LayerMap();
+    LayerMap& operator=(const LayerMap&) = default;
+    LayerMap& operator=(LayerMap&&) = default;
 
     StrVecType operator[](const StrVecType&) const;
     StrVecType operator[](const string&) const;
 
     //adds to category a layer
     void add(const string, const string);
+    //removes a layer from a category, the category is removed when it has no layers left
+    void remove(const string&, const string&);
+    //replaces the layers of a category
+    void set(const string&, const StrVecType&);
+    //returns the category mapping, read only
+    const StrMapType& strMap() const;
     //returns the  category names in this LayerMap
     const StrVecType categories() const;
     //returns the  category names for a given layer name
-    const StrVecType categories(string&) const;
+    const StrVecType categories(const string&) const;
     //Get a vector of category names for each category type
     const StrVecType categoriesByType(const categorizeType&) const;
     //test if a category contains an element
     bool isMember(const string&, const string&) const;
-    //test if a category contains an element
+    //test if this LayerMap has a (public) category
     bool contains(const string&) const;
-    //test if a category contains a multiple elements
+    //test if this LayerMap has all of the (public) categories, in any order
     bool contains(const StrVecType&) const;
     //returns a vector of unique layer names in this LayerMap
     const StrVecType uniqueLayers() const;
+    //iterates over the (public) category names, without copying them
+    RangeView<CategoryIterator> categoriesView() const;
+    //iterates over the category names for a category type, without copying them
+    RangeView<CategoryIterator> categoriesView(const categorizeType&) const;
+    //returns the layers of a category, or an empty vector, without copying them
+    const StrVecType& members(const string&) const;
+    //each layer name in this LayerMap once, without copying them. Every iteration of the view starts over
+    UniqueLayersView uniqueLayersView() const;
     //returns the contents of the object in string form
     string toString() const;
     bool empty() const;
@@ -94,19 +218,106 @@ public:
 class LayerCollection {
 
 private:
-    // takes a given layer name and returns a base category prefix or and empty string otherwise
-    string dePrefix(const string) const;
+    // interned layer configuration and its category hierarchy, built at construction
+    LayerIndex m_layerIndex;
+    // compiled "_prefix" layer configuration
+    PrefixMatcher m_prefixMatcher;
+    // category id masks for each categorizeType
+    CategoryBitset m_publicCategories;
+    CategoryBitset m_privateCategories;
+    // builds the interned layer configuration and the layers LayerMap, from the layer configuration
+    // with the names of the categories its categories merge
+    void _buildIndex(ConfigMapType);
+    // returns the category id mask of a given category type
+    const CategoryBitset& _categoryMaskByType(const categorizeType&) const;
+    // sorted category id lists of a layer name and its de-prefixed name, exact and pattern matches, returns the amount
+    size_t _categoryLists(const StrView&, bool dePrefixedOnly, const vector<IdType>* lists[4]) const;
+    // fills a vector with the sorted unique category ids of a layer name and its de-prefixed name
+    void _layerCategoryIds(const StrView&, bool dePrefixedOnly, vector<IdType>&) const;
+    // compiles the layers a CategorizeFilter keeps to a FilterProgram, and returns the categories to output,
+    // foundCats for ONLY : the filter categories of a categorizeType
+    const CategoryBitset& _compileFilter(const CategorizeFilter&, const categorizeType&, FilterProgram&, CategoryBitset& foundCats) const;
+    // channel tables of each topologyStyle, indexed by the enum value
+    TopologyTable m_topologies[2];
+    // memoized categorizeLayers results
+    mutable LayerMapCache m_categorizeCache;
+    unsigned long m_generation;
+    // categorizes the layers of a started CategorizeResult, filtered when a CategorizeFilter is given
+    void _categorizeResult(const categorizeType&, const CategorizeFilter*, CategorizeResult&) const;
+    // categorizes layer lists in parallel, in chunks sharing a CategorizeResult
+    vector<LayerMap> _categorizeBatch(const vector<StrVecType>&, const categorizeType&, const CategorizeFilter*) const;
+    // sorted unique layer names of layers or channels, and the cache key describing a request
+    StrVecType _cacheKey(const StrVecType&, const categorizeType&, const CategorizeFilter*, string&) const;
+    // takes a given layer name and returns its base category prefix, or the layer name otherwise
+    const string& dePrefix(const string&) const;
 
 public:
-    // default constructor
+    // default constructor, uses the embedded configurations, with the configurations defined by the environment
+    // variables on top of them when set. See LayerSetEmbedded.h
     LayerCollection();
+    // loads the given layer and channel configuration files, tagged with a generation number.
+    // overEmbedded puts them on top of the embedded configurations, like the default constructor
+    LayerCollection(const string&, const string&, unsigned long generation = 0, bool overEmbedded = false);
+    // loads and merges lists of layer and channel configuration files, see loadConfigsToMap
+    LayerCollection(const StrVecType&, const StrVecType&, unsigned long generation = 0);
+    // uses the merged layer and channel configuration stacks, see LayerSetOverlay.h
+    LayerCollection(const ConfigStack&, const ConfigStack&, unsigned long generation = 0);
     // returns a LayerMap of categorized items
     LayerMap categorizeLayers(const StrVecType&, const categorizeType&) const;
     // returns a LayerMap of categorized items, but filtered with a CategorizeFilter
     LayerMap categorizeLayers(const StrVecType&, const categorizeType&, const CategorizeFilter& catFilter) const;
+    // fills a reusable CategorizeResult with categorized items, doesn't allocate once the result is warm
+    void categorizeLayers(const StrVecType&, const categorizeType&, CategorizeResult&) const;
+    // fills a reusable CategorizeResult with categorized items, but filtered with a CategorizeFilter
+    void categorizeLayers(const StrVecType&, const categorizeType&, const CategorizeFilter&, CategorizeResult&) const;
+    // the same four categorizations, for layer or channel names the caller owns. Channel names are split
+    // into views, nothing is copied but the unknown layer names of a CategorizeResult
+    LayerMap categorizeLayers(const StrViewSpan&, const categorizeType&) const;
+    LayerMap categorizeLayers(const StrViewSpan&, const categorizeType&, const CategorizeFilter&) const;
+    void categorizeLayers(const StrViewSpan&, const categorizeType&, CategorizeResult&) const;
+    void categorizeLayers(const StrViewSpan&, const categorizeType&, const CategorizeFilter&, CategorizeResult&) const;
+    // updates a LayerMap categorized from a layer list after layers were added to and removed from the list.
+    // Only those layers are categorized : the result is the categorization of the previous list without
+    // the removed layers, followed by the added ones
+    void updateCategorizedLayers(LayerMap&, const StrVecType& addedLayers, const StrVecType& removedLayers, const categorizeType&) const;
+    // updates a LayerMap categorized with a CategorizeFilter, the same filter has to be used
+    void updateCategorizedLayers(LayerMap&, const StrVecType& addedLayers, const StrVecType& removedLayers, const categorizeType&, const CategorizeFilter&) const;
+    // categorizes many layer lists on all cores, results are in input order
+    vector<LayerMap> categorizeLayers(const vector<StrVecType>&, const categorizeType&) const;
+    // categorizes many layer lists on all cores with a CategorizeFilter, results are in input order
+    vector<LayerMap> categorizeLayers(const vector<StrVecType>&, const categorizeType&, const CategorizeFilter&) const;
+    // returns a shared LayerMap of categorized items, memoized. Layers are categorized in sorted order
+    LayerMapPtr cachedCategorizeLayers(const StrVecType&, const categorizeType&) const;
+    // returns a shared LayerMap of categorized items filtered with a CategorizeFilter, memoized
+    LayerMapPtr cachedCategorizeLayers(const StrVecType&, const categorizeType&, const CategorizeFilter&) const;
+    // the categorization cache, for its hit and miss counters
+    const LayerMapCache& categorizeCache() const;
+    // returns the category names a layer name belongs to in the layer configuration
+    StrVecType categoriesOf(const StrView&) const;
+    // returns the category names of a categorizeType a layer name can be categorized in, the ones of its
+    // de-prefixed name included and "all" excluded. A CategorizeFilter keeps some of them
+    StrVecType categoriesOf(const StrView&, const categorizeType&) const;
+    // test if a layer name is in a category, merged layers included. A bit test for configured layer names
+    bool isMember(const StrView& categoryName, const StrView& layerName) const;
+    // test if a category is nested in another one, directly or not, see LayerIndex
+    bool isSubcategory(const StrView& categoryName, const StrView& subcategoryName) const;
+    // returns the names of the direct subcategories of a category, the categories it merges with "<<" merge keys
+    StrVecType subcategories(const StrView&) const;
     //The notion of topology is basically adding, for example ".red" to a layer name based on a topologyStyle.
     //Unknown layer names return as .red, .green, .blue, .alpha or A, B, G, R
     LayerMap topology(const StrVecType&, const topologyStyle&) const;
+    // writes the topology channel names of layers to a ChannelNameBuffer, returns the amount of names written
+    size_t topology(const StrVecType&, const topologyStyle&, ChannelNameBuffer&) const;
+    // the same for layer or channel names the caller owns, they can't view the names of the buffer written to
+    size_t topology(const StrViewSpan&, const topologyStyle&, ChannelNameBuffer&) const;
+    // channel names ("red", "R"...) of a layer name for a topologyStyle, without the layer name
+    const StrVecType& topologyChannels(const StrView&, const topologyStyle&) const;
+
+    // takes a given layer name and returns its base category prefix ("_prefix" configuration), or the layer name otherwise
+    StrView dePrefix(const StrView&) const;
+
+    // generation number given at construction, to tell reloaded configurations apart
+    unsigned long generation() const;
 
     // houses the map to channel configurations
     LayerMap channels;
@@ -116,9 +327,14 @@ public:
     virtual ~LayerCollection();
 };
 
+// shared LayerCollection, kept alive as long as someone reads it
+typedef std::shared_ptr<const LayerCollection> LayerCollectionPtr;
+
 //Various useful functions
  namespace utilities {
     string getLayerFromChannel(const string&);
+    // the layer name of a channel name as a view, "diffuse_direct" for "diffuse_direct.R"
+    StrView getLayerViewFromChannel(const StrView&);
     StrVecType applyChannelNames(const string&, const StrVecType&);
 } // utilities
  
\ No newline at end of file
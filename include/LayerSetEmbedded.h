@@ -0,0 +1,76 @@
+/*
+ * File:   LayerSetEmbedded.h
+ *
+ * Default layer and channel configurations compiled in the library, used without any file I/O.
+ */
+#pragma once
+#include <cstdint>
+
+#include "LayerSetTypes.h"
+
+// set to 0 to ignore the embedded configurations, the configuration environment variables are then required
+#define EMBEDDED_ENV_VAR "LAYER_ALCHEMY_EMBEDDED_CONFIG"
+
+// a category of an embedded configuration, its values are values[first] to values[first + count - 1]
+struct EmbeddedCategory {
+    const char* name;
+    unsigned size;
+    unsigned first;
+    unsigned count;
+};
+
+/**
+ * Constant tables of a configuration, generated at build time by ConfigEmbedder.
+ *
+ * Category names are found with a minimal perfect hash : the hash of a name selects a bucket,
+ * the seed of the bucket gives the slot of the category. Lookups hash twice and compare once.
+ */
+struct EmbeddedConfig {
+    const EmbeddedCategory* categories;
+    unsigned categoryCount;
+    const char* const* values;
+    // seed of each bucket
+    const unsigned* seeds;
+    unsigned bucketCount;
+    // category index of each slot, categoryCount slots
+    const unsigned* slots;
+};
+
+// FNV-1a, usable at compile time
+constexpr uint32_t embeddedHash(const char* characters, size_t size, uint32_t hash = 2166136261u) {
+    return size ? embeddedHash(characters + 1, size - 1, (hash ^ static_cast<unsigned char>(*characters)) * 16777619u) : hash;
+}
+
+// starting value of the hash for a bucket seed, seed 0 is plain FNV-1a
+constexpr uint32_t embeddedSeed(unsigned seed) {
+    return 2166136261u ^ (seed * 2654435761u);
+}
+
+constexpr bool _embeddedEqual(const char* a, const char* b, size_t size) {
+    return !size || (*a == *b && _embeddedEqual(a + 1, b + 1, size - 1));
+}
+
+constexpr int _embeddedMatch(const EmbeddedConfig& config, unsigned index, const char* name, size_t size) {
+    return (config.categories[index].size == size && _embeddedEqual(config.categories[index].name, name, size)) ?
+        static_cast<int>(index) : -1;
+}
+
+constexpr unsigned _embeddedSlot(const EmbeddedConfig& config, const char* name, size_t size) {
+    return embeddedHash(name, size, embeddedSeed(config.seeds[embeddedHash(name, size) % config.bucketCount])) %
+        config.categoryCount;
+}
+
+// index of a category in an embedded configuration, or -1
+constexpr int embeddedCategoryIndex(const EmbeddedConfig& config, const char* name, size_t size) {
+    return config.categoryCount ? _embeddedMatch(config, config.slots[_embeddedSlot(config, name, size)], name, size) : -1;
+}
+
+// false if EMBEDDED_ENV_VAR is set to 0
+bool embeddedConfigEnabled();
+const EmbeddedConfig& embeddedLayerConfig();
+const EmbeddedConfig& embeddedChannelConfig();
+// the contents of an embedded configuration
+StrMapType embeddedConfigToMap(const EmbeddedConfig&);
+// an embedded configuration with a loaded configuration on top of it. Values of categories found in both
+// are either merged into a sorted set (layer sets), or replaced (channel lists)
+StrMapType overlayEmbeddedConfig(const EmbeddedConfig&, const StrMapType& overlay, bool mergeValues);
@@ -0,0 +1,283 @@
+/*
+ * File:   LayerSetIndex.h
+ *
+ * Interned name tables and membership bitsets, used by LayerCollection to categorize
+ * layer names with integer lookups instead of string comparisons.
+ */
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+
+#include "LayerSetConfig.h"
+
+// Type alias for the dense integer id given to an interned name
+typedef unsigned IdType;
+// id returned for names that are not interned
+static const IdType INVALID_ID = static_cast<IdType>(-1);
+
+/**
+ * Set of bits sized at runtime, used to store membership of interned ids
+ */
+class CategoryBitset {
+public:
+    CategoryBitset();
+    explicit CategoryBitset(size_t);
+    // changes the amount of bits, new bits are unset
+    void resize(size_t);
+    // unsets all bits
+    void reset();
+    void set(size_t);
+    void unset(size_t);
+    bool test(size_t) const;
+    // true if at least one bit is set
+    bool any() const;
+    // amount of bits set
+    size_t count() const;
+    // true if every bit set is also set in another bitset
+    bool isSubsetOf(const CategoryBitset&) const;
+    // true if a bit is set in both bitsets
+    bool intersects(const CategoryBitset&) const;
+    size_t size() const;
+    CategoryBitset& operator|=(const CategoryBitset&);
+    CategoryBitset& operator&=(const CategoryBitset&);
+private:
+    vector<uint64_t> m_words;
+    size_t m_size;
+};
+
+/**
+ * Boolean expression over categories, compiled to postfix instructions on category bitsets.
+ *
+ * A leaf is true for layers in at least one category of its mask, leaves joined by an OP_OR are merged
+ * in a single mask. A layer is evaluated with a bitset of its categories, and a stack of booleans held
+ * in the bits of one word : each instruction costs a few word operations, and evaluating doesn't allocate.
+ * Programs keep their memory when cleared, to be rebuilt for every categorization.
+ */
+class FilterProgram {
+public:
+    enum OpCode : uint8_t {
+        // pushes true if the layer is in a category of the mask
+        OP_ANY = 0,
+        OP_NOT,
+        OP_AND,
+        OP_OR,
+        // pushes true
+        OP_TRUE
+    };
+    // deepest stack a program can use, one bit per boolean
+    static const size_t MAX_DEPTH = 64;
+    FilterProgram();
+    // forgets the instructions, for categories ids lower than categoryCount
+    void clear(size_t categoryCount);
+    // adds an OP_ANY, returns its empty mask to set category ids in
+    CategoryBitset& pushAny();
+    // adds an instruction, throws std::invalid_argument when its operands are missing or the stack is too deep
+    void push(OpCode);
+    // result for the sorted category ids of a layer, the program has to leave a single boolean
+    bool evaluate(const vector<IdType>& categoryIds);
+    // amount of instructions
+    size_t size() const;
+private:
+    struct Instruction {
+        OpCode code;
+        unsigned mask;
+    };
+    vector<Instruction> m_instructions;
+    // only the first m_maskCount masks are used, the others keep their memory
+    vector<CategoryBitset> m_masks;
+    size_t m_maskCount;
+    size_t m_categoryCount;
+    // booleans on the stack after the instructions
+    size_t m_depth;
+    // categories of the evaluated layer, unset after each evaluation
+    CategoryBitset m_layerCategories;
+};
+
+/**
+ * Bidirectional mapping of names to dense ids, ids are given in insertion order
+ */
+class StringTable {
+public:
+    StringTable();
+    // copies rebuild the lookup table, it views the names of its own table
+    StringTable(const StringTable&);
+    StringTable& operator=(const StringTable&);
+    StringTable(StringTable&&) = default;
+    StringTable& operator=(StringTable&&) = default;
+    // returns the id of a name, adding it if needed
+    IdType intern(const string&);
+    // returns the id of a name, or INVALID_ID. Looking up a view doesn't allocate
+    IdType find(const StrView&) const;
+    const string& name(IdType) const;
+    size_t size() const;
+private:
+    // keys view the names, a deque never moves its elements so the views stay valid
+    std::unordered_map<StrView, IdType> m_ids;
+    std::deque<string> m_names;
+};
+
+/**
+ * Aho-Corasick automaton matching a list of layer name prefixes.
+ *
+ * A prefix is found when it is followed by "_" anywhere in a layer name. All prefixes are
+ * searched in a single pass over the name, without allocating.
+ */
+class PrefixMatcher {
+public:
+    PrefixMatcher();
+    explicit PrefixMatcher(const StrVecType&);
+    // returns the position of the last prefix in the list found in a name, or -1
+    int match(const StrView&) const;
+    const string& prefix(int) const;
+private:
+    StrVecType m_prefixes;
+    // indexed by state * 256 + byte, the next state
+    vector<int> m_transitions;
+    // indexed by state, the highest prefix position recognized in this state, or -1
+    vector<int> m_matches;
+};
+
+// true for layer names using glob pattern characters : "*", "?" or "[...]"
+bool isLayerPattern(const StrView&);
+
+/**
+ * Glob patterns of layer names ("RGBA_key_*", "crypto_asset[0-9][0-9]"), compiled to a single DFA.
+ *
+ * Supports "*" (any characters), "?" (one character), "[abc]", "[a-z]", "[!abc]" and "\" escapes.
+ * Bytes are grouped in classes that all patterns treat the same, to keep the transition table small.
+ * A match runs in one pass over the name and reports the categories of every matching pattern,
+ * whatever the amount of patterns.
+ */
+class PatternMatcher {
+public:
+    PatternMatcher();
+    // patterns and the category id of each of them, a pattern may be repeated for several categories
+    PatternMatcher(const StrVecType& patterns, const vector<IdType>& categoryIds);
+    // sorted category ids of the patterns matching a whole name
+    const vector<IdType>& match(const StrView&) const;
+    bool empty() const;
+    // amount of DFA states, for diagnostics
+    size_t stateCount() const;
+private:
+    // byte -> byte class
+    unsigned char m_classes[256];
+    size_t m_classCount;
+    // state before the first character
+    unsigned m_start;
+    // indexed by state * m_classCount + byte class, the next state. State 0 is the dead state
+    vector<unsigned> m_transitions;
+    // indexed by state, sorted category ids of the patterns accepted in this state
+    vector<vector<IdType> > m_accepts;
+};
+
+/**
+ * Interned view of a layer configuration (category name -> layer names).
+ *
+ * Category ids follow the sorted order of the configuration keys, and each category
+ * stores its members as a bitset of layer ids. Layer names that are patterns are compiled
+ * to a PatternMatcher instead.
+ * The inverse index (layer id -> category ids) is built at the same time.
+ *
+ * Categories merging others ("<<: *crypto_asset") are the edges of the category hierarchy, a DAG
+ * unless configuration files merge each other's categories. The merged categories are the direct
+ * subcategories, and each category keeps the bitset of all its subcategories (the transitive closure).
+ * Members are the ones of the configuration, which copies the merged values in each file like yaml does :
+ * a category extended by a later file doesn't add its new layers to the categories that merged it.
+ */
+class LayerIndex {
+public:
+    LayerIndex();
+    // removal categories are skipped, merged categories that aren't in the configuration are ignored
+    explicit LayerIndex(const ConfigMapType&);
+    // id of a layer name, INVALID_ID when the layer is unknown to the configuration
+    IdType layerId(const StrView&) const;
+    // id of a category name, INVALID_ID when the category is unknown to the configuration
+    IdType categoryId(const StrView&) const;
+    const string& layerName(IdType) const;
+    const string& categoryName(IdType) const;
+    size_t layerCount() const;
+    size_t categoryCount() const;
+    // test if a category contains a layer, invalid ids are never members
+    bool isMember(IdType categoryId, IdType layerId) const;
+    // true for categories starting with "_"
+    bool isPrivate(IdType categoryId) const;
+    // sorted ids of the categories a layer id belongs to, empty for invalid ids
+    const vector<IdType>& categoriesOf(IdType layerId) const;
+    // sorted ids of the categories with a layer pattern matching a layer name
+    const vector<IdType>& patternCategoriesOf(const StrView&) const;
+    bool hasPatterns() const;
+    // test if a category is a subcategory of another, directly or not
+    bool isSubcategory(IdType categoryId, IdType subcategoryId) const;
+    // ids of the subcategories of a category, directly or not
+    const CategoryBitset& subcategoriesOf(IdType categoryId) const;
+    // sorted ids of the direct subcategories of a category, the categories it merges
+    const vector<IdType>& directSubcategoriesOf(IdType categoryId) const;
+private:
+    // layer names of the configuration that are patterns, they are not interned
+    PatternMatcher m_patterns;
+    StringTable m_layers;
+    StringTable m_categories;
+    // indexed by category id, bits are layer ids
+    vector<CategoryBitset> m_members;
+    // indexed by layer id, sorted category ids
+    vector<vector<IdType> > m_layerCategories;
+    // indexed by category id
+    vector<bool> m_privateCategories;
+    // indexed by category id, bits are the ids of all the subcategories
+    vector<CategoryBitset> m_subcategories;
+    // indexed by category id, sorted ids of the direct subcategories
+    vector<vector<IdType> > m_directSubcategories;
+};
+
+/**
+ * Channel names of each topology category for one topologyStyle, resolved to category ids at load.
+ *
+ * Topology categories are given in priority order, a layer gets the channels of its last matching
+ * topology category, or the default channels if it has none.
+ */
+class TopologyTable {
+public:
+    TopologyTable();
+    // topology category names in priority order with their channel names, and the default channel names
+    TopologyTable(const LayerIndex&, const StrVecType& topologyCategories, const vector<StrVecType>& topologyChannels,
+                  const StrVecType& defaultChannels);
+    // priority of a category, -1 for categories without topology
+    int position(IdType categoryId) const;
+    // channel names for the highest priority of a layer's categories, the default channels for -1
+    const StrVecType& channels(int position) const;
+private:
+    // indexed by category id, position in m_channels or -1 for categories without topology
+    vector<int> m_positions;
+    vector<StrVecType> m_channels;
+    StrVecType m_defaultChannels;
+};
+
+/**
+ * Reusable arena of "layer.channel" names.
+ *
+ * Names are written one after the other in a single character buffer, null terminated, so building
+ * the channel names of many layers costs a few buffer growths instead of one allocation per name.
+ * Clearing keeps the memory for the next use.
+ */
+class ChannelNameBuffer {
+public:
+    ChannelNameBuffer();
+    // forgets the names, but keeps the memory
+    void clear();
+    // writes "layerName.channelName" for each channel name, returns the amount of names written
+    size_t append(const StrView& layerName, const StrVecType& channelNames);
+    // amount of names in the buffer
+    size_t size() const;
+    // null terminated name, valid until the next append or clear
+    const char* name(size_t) const;
+    size_t length(size_t) const;
+    // view of a name, to categorize the names without copying them
+    StrView view(size_t) const;
+    // copies the names to strings
+    StrVecType names() const;
+private:
+    string m_characters;
+    // start of each name in m_characters, plus the end of the last one
+    vector<size_t> m_offsets;
+};
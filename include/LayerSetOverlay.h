@@ -0,0 +1,51 @@
+/*
+ * File:   LayerSetOverlay.h
+ *
+ * Ordered stacks of configurations, sharing the categories they don't change.
+ */
+#pragma once
+#include <memory>
+
+#include "LayerSetConfig.h"
+
+/**
+ * A base configuration, with overlays on top of it in order, like a show stacking arnold5.yaml, nuke.yaml
+ * and facility.yaml on layers.yaml.
+ *
+ * An overlay is a configuration file : its categories add their values to the ones below, and categories
+ * tagged REMOVE_TAG remove theirs. Categories left empty by a removal are removed.
+ *
+ * Stacks can't be modified, pushing an overlay gives a new stack referencing the one below it and holding
+ * only the categories the overlay changed. Stacks built on the same base share it, they cost the size of
+ * their overlays.
+ */
+class ConfigStack {
+public:
+    // an empty configuration
+    ConfigStack();
+    explicit ConfigStack(ConfigMapType base);
+    // mergeValues tells if the categories are sets, like overlayEmbeddedConfig
+    ConfigStack(const StrMapType& base, bool mergeValues);
+    // loads a configuration file or directory as the base, the files of a directory are a single level
+    static ConfigStack load(const string& path);
+
+    // a new stack with an overlay on top of this one
+    ConfigStack push(const ConfigMapType& overlay) const;
+    // a new stack with an overlay file or directory on top of this one
+    ConfigStack push(const string& overlayPath) const;
+
+    // values of a category, nullptr if no level has it or it was removed
+    const ConfigValues* find(const string&) const;
+    bool contains(const string&) const;
+    // the categories of all levels merged, with the names of the categories they merge, to build a LayerIndex
+    ConfigMapType toConfigMap() const;
+    // the categories of all levels merged, to build a LayerMap
+    StrMapType toMap() const;
+    // amount of overlays on top of the base
+    size_t depth() const;
+
+private:
+    struct Level;
+    std::shared_ptr<const Level> m_top;
+    explicit ConfigStack(std::shared_ptr<const Level>);
+};
@@ -0,0 +1,51 @@
+/*
+ * File:   LayerSetParallel.h
+ *
+ * Minimal helper to run independent tasks on a few threads.
+ */
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <vector>
+
+// upper bound on the threads used by parallelFor, loading configurations doesn't need more
+static const unsigned PARALLEL_MAX_THREADS = 8;
+
+/**
+ * Calls function(index) for every index in [0, count) on up to maxThreads threads (and up to the
+ * amount of cores), and returns once all calls are done.
+ *
+ * If calls throw, the exception of the lowest index is rethrown, so errors are reported
+ * the same way whatever the scheduling was.
+ */
+template <typename Function>
+void parallelFor(size_t count, Function function, unsigned maxThreads = PARALLEL_MAX_THREADS) {
+    unsigned threadCount = std::max(1u, std::min(std::thread::hardware_concurrency(), maxThreads));
+    threadCount = static_cast<unsigned>(std::min<size_t>(threadCount, count));
+    std::vector<std::exception_ptr> errors(count);
+    std::atomic<size_t> nextIndex(0);
+    auto worker = [&]() {
+        for (size_t index = nextIndex++; index < count; index = nextIndex++) {
+            try {
+                function(index);
+            } catch (...) {
+                errors[index] = std::current_exception();
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < threadCount; i++) {
+        threads.emplace_back(worker);
+    }
+    worker(); // the calling thread works too
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (const auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
@@ -0,0 +1,109 @@
+/*
+ * File:   LayerSetResult.h
+ *
+ * Reusable categorization results, filled without allocating once their memory is warm.
+ */
+#pragma once
+#include <memory>
+
+#include "LayerSetTypes.h"
+#include "LayerSetIndex.h"
+
+class LayerMap;
+class LayerCollection;
+
+/**
+ * Bump allocator for characters. Memory is only released on destruction, reset() rewinds to the
+ * first block and keeps all of them for the next use.
+ */
+class MonotonicArena {
+public:
+    explicit MonotonicArena(size_t blockSize = 4096);
+    MonotonicArena(const MonotonicArena&) = delete;
+    MonotonicArena& operator=(const MonotonicArena&) = delete;
+    // copies characters in the arena, the copy is valid until reset
+    StrView copy(const StrView&);
+    // forgets all copies, keeps the memory
+    void reset();
+    // total amount of bytes reserved
+    size_t capacity() const;
+private:
+    vector<std::unique_ptr<char[]> > m_blocks;
+    vector<size_t> m_blockSizes;
+    size_t m_blockSize;
+    // block being filled and amount of bytes used in it
+    size_t m_current;
+    size_t m_used;
+};
+
+/**
+ * Caller owned result of LayerCollection::categorizeLayers, to reuse between calls.
+ *
+ * Same contents as the LayerMap version : categories sorted by name, layers in input order.
+ * Category names and known layer names view the LayerCollection's string tables, unknown layer
+ * names are copied in an arena. Views are valid until the next categorization into this result,
+ * and as long as the LayerCollection lives.
+ */
+class CategorizeResult {
+public:
+    typedef RangeView<const StrView*> MemberRange;
+
+    CategorizeResult();
+    CategorizeResult(const CategorizeResult&) = delete;
+    CategorizeResult& operator=(const CategorizeResult&) = delete;
+    // forgets the contents, keeps the memory
+    void clear();
+    // amount of categories
+    size_t size() const;
+    bool empty() const;
+    // name of the category at an index
+    StrView category(size_t) const;
+    // layers of the category at an index
+    MemberRange members(size_t) const;
+    // layers of a category, empty if the category is missing
+    MemberRange members(const StrView&) const;
+    // index of a category, or -1
+    int find(const StrView&) const;
+    // test if this result has a (public) category
+    bool contains(const StrView&) const;
+    // test if a category contains a layer
+    bool isMember(const StrView&, const StrView&) const;
+    // copies the contents to a LayerMap
+    LayerMap toLayerMap() const;
+
+private:
+    friend class LayerCollection;
+    struct Category {
+        StrView name;
+        size_t first;
+        size_t count;
+    };
+    // clears the result and finds the unique layer names of the input, known or copied in the arena
+    void _start(const StrVecType&, const LayerIndex&);
+    void _start(const StrViewSpan&, const LayerIndex&);
+    // keeps the first of the layer names added by _start, as the known name or a copy in the arena
+    void _uniqueLayers(const LayerIndex&);
+    // adds a layer to "all", once
+    void _addToAll(unsigned layer);
+    // adds a layer to a category id, ids of the "all" category are redirected to _addToAll
+    void _add(IdType categoryId, unsigned layer);
+    // groups the memberships by category in sorted category name order
+    void _build(const LayerIndex&);
+
+    vector<Category> m_categories;
+    vector<StrView> m_members;
+    MonotonicArena m_arena;
+
+    // working memory, kept between calls
+    IdType m_allCategoryId;
+    // last layer added to "all"
+    unsigned m_lastAllLayer;
+    vector<StrView> m_layers;
+    vector<unsigned> m_order;
+    vector<std::pair<IdType, unsigned> > m_memberships;
+    vector<size_t> m_offsets;
+    vector<size_t> m_cursors;
+    FilterProgram m_filterProgram;
+    vector<IdType> m_layerCategories;
+    CategoryBitset m_foundCategories;
+};
@@ -0,0 +1,92 @@
+/*
+ * File:   LayerSetStats.h
+ *
+ * Opt-in counters and timers of the core library, dumped as JSON at process exit.
+ */
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+
+#include "LayerSetTypes.h"
+
+// path of the JSON file written at process exit, statistics are only collected when it is set
+#define STATS_ENV_VAR "LAYER_ALCHEMY_STATS"
+
+namespace stats {
+
+enum Counter {
+    configLoads = 0,
+    categorizeCalls,
+    layersCategorized,
+    cacheHits,
+    cacheMisses,
+    topologyCalls,
+    // LayerMaps built by categorizations and topology, each allocates a tree of strings
+    layerMapsBuilt,
+    // memory blocks allocated by CategorizeResult arenas
+    arenaBlocks,
+    counterCount
+};
+
+enum Timer {
+    configLoadTime = 0,
+    categorizeTime,
+    topologyTime,
+    timerCount
+};
+
+// true if STATS_ENV_VAR is set, read once
+inline bool enabled() {
+    static const bool statsEnabled = getenv(STATS_ENV_VAR) != nullptr;
+    return statsEnabled;
+}
+
+// adds to a counter of the calling thread, only call when enabled()
+void _add(Counter, uint64_t);
+void _addTime(Timer, uint64_t nanoseconds);
+
+inline void add(Counter counter, uint64_t amount = 1) {
+    if (enabled()) {
+        _add(counter, amount);
+    }
+}
+
+/**
+ * Adds the time spent in a scope to a timer, and counts one call.
+ * The clock is not read when statistics are disabled.
+ */
+class ScopedTimer {
+public:
+    ScopedTimer(Timer timer, Counter calls) : m_timer(timer), m_enabled(enabled()) {
+        if (m_enabled) {
+            _add(calls, 1);
+            m_start = std::chrono::steady_clock::now();
+        }
+    }
+    ~ScopedTimer() {
+        if (m_enabled) {
+            std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - m_start;
+            _addTime(m_timer, static_cast<uint64_t>(elapsed.count()));
+        }
+    }
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+private:
+    Timer m_timer;
+    bool m_enabled;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+// totals of all threads, past and present
+struct Totals {
+    uint64_t counters[counterCount];
+    uint64_t nanoseconds[timerCount];
+};
+Totals totals();
+// totals as a JSON object
+string toJson();
+// writes the totals to a JSON file, returns false if the file can't be written
+bool dump(const string& filePath);
+
+} // stats
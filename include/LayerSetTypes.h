@@ -5,6 +5,10 @@
  * Created on November 22, 2018, 6:28 p.m.
  */
 #pragma once
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <iterator>
 #include <string>
 #include <vector>
 #include <map>
@@ -17,3 +21,82 @@ using std::map;
 typedef vector<string> StrVecType;
 // Type alias for storing layer category names and a vector of layer names
 typedef map<string, vector<string> > StrMapType;
+
+/**
+ * Non owning view of characters, a minimal C++11 stand-in for std::string_view.
+ * The viewed characters must outlive the view.
+ */
+class StrView {
+public:
+    StrView() : m_data(""), m_size(0) {}
+    StrView(const char* data, size_t size) : m_data(data), m_size(size) {}
+    StrView(const char* data) : m_data(data), m_size(strlen(data)) {}
+    StrView(const string& str) : m_data(str.data()), m_size(str.size()) {}
+    const char* data() const {return m_data;}
+    size_t size() const {return m_size;}
+    bool empty() const {return m_size == 0;}
+    const char* begin() const {return m_data;}
+    const char* end() const {return m_data + m_size;}
+    char operator[](size_t index) const {return m_data[index];}
+    // position of the first matching character, or string::npos
+    size_t find(char character) const {
+        const void* found = m_size ? memchr(m_data, character, m_size) : nullptr;
+        return found ? static_cast<const char*>(found) - m_data : string::npos;
+    }
+    StrView substr(size_t position, size_t count = string::npos) const {
+        return StrView(m_data + position, std::min(count, m_size - position));
+    }
+    int compare(const StrView& other) const {
+        int result = memcmp(m_data, other.m_data, std::min(m_size, other.m_size));
+        return result != 0 ? result : (m_size < other.m_size ? -1 : (m_size > other.m_size ? 1 : 0));
+    }
+    string str() const {return string(m_data, m_size);}
+private:
+    const char* m_data;
+    size_t m_size;
+};
+
+inline bool operator==(const StrView& a, const StrView& b) {
+    return a.size() == b.size() && memcmp(a.data(), b.data(), a.size()) == 0;
+}
+inline bool operator!=(const StrView& a, const StrView& b) {return !(a == b);}
+inline bool operator<(const StrView& a, const StrView& b) {return a.compare(b) < 0;}
+
+namespace std {
+template <>
+struct hash<StrView> {
+    // FNV-1a
+    size_t operator()(const StrView& view) const {
+        size_t hash = static_cast<size_t>(14695981039346656037ULL);
+        for (unsigned char character : view) {
+            hash ^= character;
+            hash *= static_cast<size_t>(1099511628211ULL);
+        }
+        return hash;
+    }
+};
+} // std
+
+/**
+ * Pair of iterators usable in range based for loops, nothing is copied
+ */
+template <typename Iterator>
+class RangeView {
+public:
+    RangeView(Iterator first, Iterator last) : m_begin(first), m_end(last) {}
+    Iterator begin() const {return m_begin;}
+    Iterator end() const {return m_end;}
+    bool empty() const {return m_begin == m_end;}
+    size_t size() const {return std::distance(m_begin, m_end);}
+private:
+    Iterator m_begin;
+    Iterator m_end;
+};
+
+// Type alias for a span of layer or channel names owned by the caller, like names of a host application
+typedef RangeView<const StrView*> StrViewSpan;
+
+// span of the views of a vector, valid until the vector changes
+inline StrViewSpan spanOf(const vector<StrView>& views) {
+    return StrViewSpan(views.data(), views.data() + views.size());
+}
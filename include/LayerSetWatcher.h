@@ -0,0 +1,61 @@
+/*
+ * File:   LayerSetWatcher.h
+ *
+ * Opt-in hot reloading of the layer and channel configuration files.
+ */
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "LayerSetCore.h"
+
+// set to 1 to reload the configuration files when they change on disk
+#define WATCH_ENV_VAR "LAYER_ALCHEMY_WATCH_CONFIG"
+
+/**
+ * Watches the layer and channel configuration files, and rebuilds a LayerCollection in the background
+ * when they change (inotify on Linux, modification time polling elsewhere).
+ *
+ * Each rebuilt LayerCollection is an immutable snapshot published atomically with a new generation number.
+ * Readers share ownership of the snapshot they got, so it stays valid while they use it, and a replaced
+ * snapshot is freed as soon as its last reader releases it.
+ */
+class LayerCollectionWatcher {
+public:
+    // loads the first snapshot, throws if the configuration can't be loaded. overEmbedded puts the
+    // configuration files on top of the embedded configurations, see LayerCollection
+    LayerCollectionWatcher(const string& layerConfigPath, const string& channelConfigPath, bool overEmbedded = false);
+    // stops watching
+    ~LayerCollectionWatcher();
+    // starts the background thread watching the configuration files
+    void start();
+    // stops the background thread
+    void stop();
+    bool running() const;
+    // the latest published LayerCollection
+    LayerCollectionPtr snapshot() const;
+    // generation number of the latest published LayerCollection
+    unsigned long generation() const;
+    // rebuilds and publishes a snapshot now. A configuration that fails to load is reported and
+    // the current snapshot is kept
+    bool reload();
+    // true if the WATCH_ENV_VAR environment variable is set to 1
+    static bool enabled();
+
+private:
+    void _watch();
+    const string m_layerConfigPath;
+    const string m_channelConfigPath;
+    const bool m_overEmbedded;
+    // only accessed through std::atomic_load and std::atomic_store
+    LayerCollectionPtr m_current;
+    std::atomic<unsigned long> m_generation;
+    // serializes reloads
+    std::mutex m_publishMutex;
+    std::thread m_thread;
+    std::atomic<bool> m_running;
+    // wakes up the background thread when stopping
+    int m_stopPipe[2];
+};
@@ -10,8 +10,12 @@
 
 namespace LayerAlchemy {
 
-    //layerCollection initialized here once.
-    static LayerCollection layerCollection;
+    // process-wide LayerCollection, loaded on first use and shared by every plugin.
+    // With LAYER_ALCHEMY_WATCH_CONFIG=1 this is the latest snapshot of the configuration watcher,
+    // hold on to the returned pointer for as long as the LayerCollection is used
+    LayerCollectionPtr layerCollection();
+    // milliseconds spent loading the process-wide LayerCollection, 0 until its first use
+    double layerCollectionLoadTime();
     //using DD::Image::ChannelSet;
     typedef map<string, DD::Image::ChannelSet> ChannelSetMapType;
 
@@ -19,12 +23,19 @@ namespace LayerSet {
     typedef map<string, DD::Image::ChannelSet> ChannelSetMapType;
     //Gets a vector of unique layer names for a ChannelSet
     StrVecType getLayerNames(const DD::Image::ChannelSet&);
+    // fills a vector with views of the layer names of a ChannelSet, without copying them. Consecutive channels
+    // of a layer give a single view, categorizing removes the remaining duplicates
+    void getLayerNameViews(const DD::Image::ChannelSet&, vector<StrView>&);
     StrVecType getCategories(const ChannelSetMapType&);
     DD::Image::ChannelSet getChannelSet(const ChannelSetMapType&);
 
     ChannelSetMapType categorizeChannelSet(const LayerCollection&, const DD::Image::ChannelSet&);
     ChannelSetMapType categorizeChannelSet(const LayerCollection&, const DD::Image::ChannelSet&, const CategorizeFilter&);
     ChannelSetMapType _layerMaptoChannelMap(const LayerMap&, const DD::Image::ChannelSet& inChannels);
+    // updates a ChannelSetMapType of previousChannels to inChannels, layerMap being the categorization of inChannels
+    // by the LayerCollection. Only the categories of the layers of the added and removed channels are visited
+    void _updateChannelMap(ChannelSetMapType&, const LayerCollection&, const LayerMap&, const categorizeType&,
+                           const DD::Image::ChannelSet& previousChannels, const DD::Image::ChannelSet& inChannels);
 } //  End namespace LayerSet
 
 namespace Utilities {
@@ -26,6 +26,16 @@ public:
     DD::Image::ChannelSet m_selectedChannels;
     // stores the ChannelSet last used, useful to compare if an update is required, or can be skipped
     DD::Image::ChannelSet m_allChannels;
+    // categorization of m_categorizedChannels, updated with the layers added and removed when the input changes
+    LayerMap m_categorized;
+    ChannelSetMapType m_channelSetLayerMap;
+    DD::Image::ChannelSet m_categorizedChannels;
+    // channels of each layer of m_categorizedChannels, a layer is added or removed with its first or last channel
+    ChannelSetMapType m_layerChannels;
+    // LayerCollection of m_categorized, a reloaded configuration categorizes everything again.
+    // The generation tells a new snapshot apart from a freed one allocated at the same address
+    const LayerCollection* m_collection {nullptr};
+    unsigned long m_collectionGeneration {0};
     LayerSetKnobData();
     ~LayerSetKnobData();
 };
@@ -51,20 +61,23 @@ void populateLayerSetKnobEnum(DD::Image::Op*, std::vector<string>&);
 bool _basicValidateLayerSetKnobUpdate(DD::Image::Op*, const LayerSetKnobData&, const DD::Image::ChannelSet&);
 // second stage of update handling : categorizes the incoming channels, and decides if an update is redundant.
 bool _categorizedValidateLayerSetKnobUpdate(DD::Image::Op*, const LayerMap&, const string&);
+bool _categorizedValidateLayerSetKnobUpdate(DD::Image::Op*, const CategorizeResult&, const string&);
 // main validation function for managing LayerSetKnob updating
-bool validateLayerSetKnobUpdate(DD::Image::Op*, const LayerSetKnobData&, LayerCollection&, const DD::Image::ChannelSet&);
+bool validateLayerSetKnobUpdate(DD::Image::Op*, const LayerSetKnobData&, const LayerCollection&, const DD::Image::ChannelSet&);
 // main validation filtered function for managing LayerSetKnob updating
-bool validateLayerSetKnobUpdate(DD::Image::Op*, const LayerSetKnobData&, LayerCollection&, const DD::Image::ChannelSet&, const CategorizeFilter&);
+bool validateLayerSetKnobUpdate(DD::Image::Op*, const LayerSetKnobData&, const LayerCollection&, const DD::Image::ChannelSet&, const CategorizeFilter&);
 
 /**
  * convenience functions for doing the actual updating of the updating of both the knob and it's storage
  */
 
+// private function categorizing the incoming channels in the knob data, only the layers added or removed since the last call are categorized
+ChannelSetMapType& _categorizeLayerSetKnobChannels(LayerSetKnobData&, const LayerCollection&, const DD::Image::ChannelSet&, const CategorizeFilter*);
 // private function to do the actual data updating to the enumeration knob
 void _updateLayerSetKnob(DD::Image::Op*, LayerSetKnobData&, ChannelSetMapType&, const DD::Image::ChannelSet&);
 // main update function to update an Op's LayerSetKnob
-void updateLayerSetKnob(DD::Image::Op*, LayerSetKnobData&, LayerCollection&, DD::Image::ChannelSet&);
+void updateLayerSetKnob(DD::Image::Op*, LayerSetKnobData&, const LayerCollection&, DD::Image::ChannelSet&);
 // main update function to update an Op's filtered LayerSetKnob
-void updateLayerSetKnob(DD::Image::Op*, LayerSetKnobData&, LayerCollection&, DD::Image::ChannelSet&, const CategorizeFilter&);
+void updateLayerSetKnob(DD::Image::Op*, LayerSetKnobData&, const LayerCollection&, DD::Image::ChannelSet&, const CategorizeFilter&);
 } //  End namespace LayerSetKnob
 } //  End namespace LayerAlchemy
@@ -0,0 +1,84 @@
+"""
+Compares ways of categorizing layer lists from a Python tool :
+
+* spawning LayerTester for each list
+* the LayerSetCore extension module, one call per list
+* the LayerSetCore extension module from several threads, the GIL is released while categorizing
+* LayerSetCore.LayerCollection.categorizeBatch
+
+usage : python categorize_benchmark.py --tester /path/to/LayerTester [--lists 2000] [--threads 4]
+LayerSetCore needs to be importable, and the configuration environment variables set.
+"""
+
+import argparse
+import random
+import subprocess
+import threading
+import time
+
+import LayerSetCore
+
+
+def _layerLists(collection, count, seed=0):
+    """random layer lists mixing configured and unknown layer names"""
+    rng = random.Random(seed)
+    knownLayers = sorted({layer for layers in collection.layers.values() for layer in layers})
+    layerLists = []
+    for index in range(count):
+        size = rng.randint(5, 60)
+        layerLists.append([rng.choice(knownLayers) if rng.random() < 0.8 else 'custom_{}'.format(rng.randint(0, 99))
+                           for _ in range(size)])
+    return layerLists
+
+
+def _timed(label, count, function):
+    start = time.time()
+    function()
+    elapsed = time.time() - start
+    print('{:<28} {:>10.3f} s {:>12.1f} lists/s'.format(label, elapsed, count / elapsed if elapsed else float('inf')))
+    return elapsed
+
+
+def _subprocess(tester, layerLists):
+    for layers in layerLists:
+        subprocess.check_output([tester, '--layers'] + layers)
+
+
+def _serial(collection, layerLists):
+    return [collection.categorizeLayers(layers) for layers in layerLists]
+
+
+def _threaded(collection, layerLists, threadCount):
+    results = [None] * threadCount
+
+    def worker(index, chunk):
+        results[index] = [collection.categorizeLayers(layers) for layers in chunk]
+    threads = [threading.Thread(target=worker, args=(index, layerLists[index::threadCount])) for index in range(threadCount)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--tester', help='path to the LayerTester executable, skips the subprocess run if not set')
+    parser.add_argument('--lists', type=int, default=2000, help='amount of layer lists')
+    parser.add_argument('--threads', type=int, default=4, help='threads for the threaded run')
+    args = parser.parse_args()
+
+    collection = LayerSetCore.LayerCollection()
+    layerLists = _layerLists(collection, args.lists)
+
+    if args.tester:  # spawning is slow, time a fraction of the lists
+        subset = layerLists[:max(1, args.lists // 20)]
+        _timed('subprocess LayerTester', len(subset), lambda: _subprocess(args.tester, subset))
+    _timed('module, serial', len(layerLists), lambda: _serial(collection, layerLists))
+    _timed('module, {} threads'.format(args.threads), len(layerLists),
+           lambda: _threaded(collection, layerLists, args.threads))
+    _timed('module, categorizeBatch', len(layerLists), lambda: collection.categorizeBatch(layerLists))
+
+
+if __name__ == '__main__':
+    main()
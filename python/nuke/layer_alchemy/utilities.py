@@ -60,10 +60,10 @@ def _validateConfigFile(configFilePath):
     Uses a binary included in the project to test a given configuration file, and will raise an exception
     if something is not valid.
     The idea if to fail fast at startup for any configuration file issue.
-    :param configFilePath: absolute path to a yaml file
+    :param configFilePath: absolute path to a yaml file, or a directory of yaml files
     :raises ValueError if configFilePath is missing or is not a valid yaml file
     """
-    if not os.path.isfile(configFilePath):
+    if not os.path.exists(configFilePath):
         raise ValueError('missing configuration file')
     return subprocess.call(
         [constants.LAYER_ALCHEMY_CONFIGTESTER_BIN, '--config', configFilePath, '--quiet']
@@ -74,11 +74,15 @@ def validateConfigFileEnvironmentVariables():
     """
     Tests if all required configurations are valid files as defined in constants.LAYER_ALCHEMY_CONFIGS_DICT.
     If current environment variable defines a custom yaml config, it will validate it.
-    If none exists, validate and set it the included default configuration
+    If none exists, the plugins use the default configuration compiled in them, unless it is disabled with
+    LAYER_ALCHEMY_EMBEDDED_CONFIG=0, then validate and set it the included default configuration
     """
+    embeddedConfig = os.environ.get('LAYER_ALCHEMY_EMBEDDED_CONFIG') != '0'
     for envVarName, baseName in constants.LAYER_ALCHEMY_CONFIGS_DICT.items():
         configFile = os.environ.get(envVarName)  # test if a custom configuration is present and validate it
         if not configFile:
+            if embeddedConfig:
+                continue
             configFile = os.path.join(constants.LAYER_ALCHEMY_CONFIGS_DIR, baseName)
             os.environ[envVarName] = configFile
         error = _validateConfigFile(configFile)
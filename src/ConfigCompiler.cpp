@@ -0,0 +1,113 @@
+/*
+ * Simple executable to compile yaml files to binary images, loaded instead of parsing the yaml
+ * usage example: ConfigCompiler --config /path/to/config.yaml
+ */
+
+#include <fstream>
+#include <dirent.h>
+
+#include "argparse.h"
+
+#include "LayerSetCore.h"
+#include "LayerSetConfigCache.h"
+#include "version.h"
+
+static const string greenText = "\x1B[92m";
+static const string redText = "\x1B[31m";
+static const string endColor = "\033[0m";
+static const string emojiOk = "\xE2\x9C\x85 ";
+static const string emojiGear = "\xE2\x9A\x99 ";
+static const string emojiError = "\xE2\x9D\x97 ";
+
+static const std::string DESCRIPTION = "Simple executable to compile yaml files to binary images";
+static const string LAYER_ALCHEMY_PROJECT_URL = "https://github.com/sebjacob/LayerAlchemy";
+
+static const string HEADER =
+    "\nConfigCompiler " + emojiGear + "\n\n" + DESCRIPTION + "\n\n"
+    "LayerAlchemy " + LAYER_ALCHEMY_VERSION_STRING + "\n" +
+     LAYER_ALCHEMY_PROJECT_URL + "\n\n"
+    "Each image is written next to its yaml file, with the '" + CONFIG_CACHE_EXTENSION + "' extension.\n"
+    "It is used until the yaml file changes, then the yaml file is parsed again.\n\n"
+    "Example usage: \n\nConfigCompiler --config /path/to/config.yaml\n"
+    "ConfigCompiler --config /path/to/config1.yaml /path/to/config2.yaml\n"
+    "ConfigCompiler --config /path/to/configs/layers";
+
+
+void logException(const char* filePath, const std::exception& e)
+{
+    std::cerr << emojiError << redText << "[ERROR] LayerAlchemy : " << filePath << " " << e.what() << std::endl << endColor;
+}
+
+int main(int argc, const char* argv[])
+{
+    ArgumentParser parser(DESCRIPTION);
+    parser.add_argument("--config", "List of yaml files, or directories of yaml files, to compile", true);
+    parser.add_argument("--quiet", "disable terminal output, return code only", false);
+
+    try
+    {
+        parser.parse(argc, argv);
+    }
+    catch (const ArgumentParser::ArgumentNotFound &ex)
+    {
+        std::cout << HEADER << std::endl;
+        parser.print_help();
+
+        std::cout << ex.what() << std::endl;
+        return 0;
+    }
+    if (parser.is_help())
+        return 0;
+
+    auto configs = parser.getv<std::string>("config");
+    bool quiet = parser.get<bool>("quiet");
+
+    StrVecType configFilePaths;
+    for (const auto& config : configs)
+    {
+        if (DIR* directory = opendir(config.c_str()))
+        { // a configuration directory compiles each of its files, they are loaded with their images
+            closedir(directory);
+            StrVecType directoryFiles = configFilesInDirectory(config);
+            configFilePaths.insert(configFilePaths.end(), directoryFiles.begin(), directoryFiles.end());
+        }
+        else
+        {
+            configFilePaths.push_back(config);
+        }
+    }
+
+    for(auto it = configFilePaths.begin(); it != configFilePaths.end(); ++it)
+    {
+        auto configFilePath = it->c_str();
+        std::ifstream inputFile(configFilePath);
+
+        if (!inputFile)
+        {
+            if (!quiet)
+            {
+                logException(configFilePath, std::invalid_argument("is not a file"));
+            }
+            return 1;
+        }
+        try
+        {
+            string cachePath = configCachePath(*it);
+            compileConfigCache(*it, cachePath);
+            if (!quiet)
+            {
+                std::cout << greenText << emojiOk << "LayerAlchemy : compiled " << configFilePath
+                << " to " << cachePath << std::endl << endColor;
+            }
+        }
+        catch (const std::exception& e)
+        {
+            if (!quiet)
+            {
+                logException(configFilePath, e);
+            }
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,170 @@
+/*
+ * Build tool writing the shipped layer and channel configurations as a C++ header of constant tables,
+ * compiled in LayerSetCore as the default configurations, see LayerSetEmbedded.h
+ * usage example: ConfigEmbedder configs/layers.yaml configs/channels.yaml LayerSetEmbeddedConfig.h
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include "LayerSetConfig.h"
+#include "LayerSetEmbedded.h"
+
+// highest bucket seed tried before giving up on a perfect hash
+static const unsigned MAX_SEED = 1u << 24;
+
+// a C++ string literal, escaping anything that isn't plain printable ascii
+static string _literal(const string& text) {
+    std::ostringstream literal;
+    literal << '"';
+    for (unsigned char character : text) {
+        // '?' too, to avoid trigraphs
+        if (character == '"' || character == '\\' || character == '?') {
+            literal << '\\' << character;
+        } else if (character < 0x20 || character > 0x7e) {
+            // always 3 digits, a following digit can't extend the escape
+            literal << '\\' << std::oct << std::setw(3) << std::setfill('0') << static_cast<unsigned>(character)
+                    << std::dec;
+        } else {
+            literal << character;
+        }
+    }
+    literal << '"';
+    return literal.str();
+}
+
+/**
+ * Hash and displace : category names are spread in buckets by their hash, then for each bucket,
+ * biggest first, a seed is searched that gives free slots to all of its names.
+ */
+static void _perfectHash(const StrVecType& names, vector<unsigned>& seeds, vector<unsigned>& slots) {
+    const unsigned nameCount = static_cast<unsigned>(names.size());
+    const unsigned bucketCount = nameCount / 2 + 1;
+    vector<vector<unsigned> > buckets(bucketCount);
+    for (unsigned index = 0; index < nameCount; index++) {
+        buckets[embeddedHash(names[index].data(), names[index].size()) % bucketCount].push_back(index);
+    }
+    vector<unsigned> order(bucketCount);
+    for (unsigned bucket = 0; bucket < bucketCount; bucket++) {
+        order[bucket] = bucket;
+    }
+    std::stable_sort(order.begin(), order.end(), [&buckets](unsigned a, unsigned b) {
+        return buckets[a].size() > buckets[b].size();
+    });
+    seeds.assign(bucketCount, 0);
+    slots.assign(nameCount, 0);
+    vector<bool> taken(nameCount, false);
+    vector<unsigned> bucketSlots;
+    for (unsigned bucket : order) {
+        if (buckets[bucket].empty()) {
+            break;
+        }
+        unsigned seed = 0;
+        for (; seed < MAX_SEED; seed++) {
+            bucketSlots.clear();
+            for (unsigned index : buckets[bucket]) {
+                unsigned slot = embeddedHash(names[index].data(), names[index].size(), embeddedSeed(seed)) % nameCount;
+                if (taken[slot] || std::find(bucketSlots.begin(), bucketSlots.end(), slot) != bucketSlots.end()) {
+                    break;
+                }
+                bucketSlots.push_back(slot);
+            }
+            if (bucketSlots.size() == buckets[bucket].size()) {
+                break;
+            }
+        }
+        if (seed == MAX_SEED) {
+            throw std::runtime_error("can't find a perfect hash of the category names");
+        }
+        seeds[bucket] = seed;
+        for (size_t index = 0; index < bucketSlots.size(); index++) {
+            taken[bucketSlots[index]] = true;
+            slots[bucketSlots[index]] = buckets[bucket][index];
+        }
+    }
+}
+
+template<typename T>
+static void _writeArray(std::ostream& header, const string& type, const string& name, const vector<T>& values) {
+    header << "static constexpr " << type << " " << name << "[] = {";
+    for (size_t index = 0; index < values.size(); index++) {
+        header << (index % 8 ? " " : "\n    ") << values[index] << ",";
+    }
+    // arrays can't be empty
+    if (values.empty()) {
+        header << "\n    " << T();
+    }
+    header << "\n};\n";
+}
+
+// writes the tables of a configuration, and checks the perfect hash at compile time
+static void _writeConfig(std::ostream& header, const string& prefix, const string& sourcePath) {
+    const StrMapType categoryMap = loadConfigToMap(sourcePath);
+    StrVecType names;
+    vector<string> categories, values;
+    unsigned first = 0;
+    for (const auto& kvp : categoryMap) {
+        names.push_back(kvp.first);
+        unsigned count = static_cast<unsigned>(kvp.second.size());
+        categories.push_back("{" + _literal(kvp.first) + ", " + std::to_string(kvp.first.size()) + ", " +
+                             std::to_string(first) + ", " + std::to_string(count) + "}");
+        for (const auto& value : kvp.second) {
+            values.push_back(_literal(value));
+        }
+        first += count;
+    }
+    vector<unsigned> seeds, slots;
+    _perfectHash(names, seeds, slots);
+    if (values.empty()) {
+        values.push_back("nullptr");
+    }
+    if (categories.empty()) {
+        categories.push_back("{\"\", 0, 0, 0}");
+    }
+
+    header << "\n// " << sourcePath << "\n";
+    _writeArray(header, "const char*", prefix + "_VALUES", values);
+    _writeArray(header, "EmbeddedCategory", prefix + "_CATEGORIES", categories);
+    _writeArray(header, "unsigned", prefix + "_SEEDS", seeds);
+    _writeArray(header, "unsigned", prefix + "_SLOTS", slots);
+    header << "static constexpr EmbeddedConfig EMBEDDED_" << prefix << "_CONFIG = {\n    "
+           << prefix << "_CATEGORIES, " << names.size() << ", " << prefix << "_VALUES, "
+           << prefix << "_SEEDS, " << seeds.size() << ", " << prefix << "_SLOTS\n};\n";
+    for (size_t index = 0; index < names.size(); index++) {
+        header << "static_assert(embeddedCategoryIndex(EMBEDDED_" << prefix << "_CONFIG, " << _literal(names[index])
+               << ", " << names[index].size() << ") == " << index << ", \"perfect hash\");\n";
+    }
+}
+
+int main(int argc, const char* argv[])
+{
+    if (argc != 4)
+    {
+        std::cerr << "usage : ConfigEmbedder layers.yaml channels.yaml output.h" << std::endl;
+        return 1;
+    }
+    std::ostringstream header;
+    try
+    {
+        header << "/*\n * Generated by ConfigEmbedder from the shipped configurations, don't edit.\n */\n"
+               << "#pragma once\n#include \"LayerSetEmbedded.h\"\n";
+        _writeConfig(header, "LAYER", argv[1]);
+        _writeConfig(header, "CHANNEL", argv[2]);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "[ERROR] LayerAlchemy : " << e.what() << std::endl;
+        return 1;
+    }
+    std::ofstream outputFile(argv[3]);
+    if (!(outputFile << header.str()))
+    {
+        std::cerr << "[ERROR] LayerAlchemy : can't write " << argv[3] << std::endl;
+        return 1;
+    }
+    return 0;
+}
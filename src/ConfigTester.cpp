@@ -1,14 +1,25 @@
 /*
- * Simple executable to test if a yaml file can be loaded and a LayerMap object can be constructed
+ * Simple executable to test if yaml files can be loaded and LayerMap objects can be constructed,
+ * and to profile what loading them costs
  * usage example: ConfigTester /path/to/config.yaml
  */
 
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
 #include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <thread>
 #include <dirent.h>
 
 #include "argparse.h"
 
+#include "LayerSetConfig.h"
 #include "LayerSetCore.h"
+#include "LayerSetParallel.h"
 #include "version.h"
 
 static const string greenText = "\x1B[92m";
@@ -25,20 +36,171 @@ static const string HEADER =
     "\nConfigTester " + emojiMedical + "\n\n" + DESCRIPTION + "\n\n"
     "LayerAlchemy " + LAYER_ALCHEMY_VERSION_STRING + "\n" +
      LAYER_ALCHEMY_PROJECT_URL + "\n\n"
-    "Example usage: \n\nConfigTester --config /path/to/config.yaml\n" 
-    "ConfigTester --config /path/to/config1.yaml /path/to/config2.yaml";
+    "Example usage: \n\nConfigTester --config /path/to/config.yaml\n"
+    "ConfigTester --config /path/to/config1.yaml /path/to/config2.yaml\n"
+    "ConfigTester --config /path/to/configs/layers --json";
 
+// heap bytes allocated and not freed yet by each thread, to measure what a loaded config keeps
+static thread_local long long threadHeapBytes = 0;
+// allocations carry their size in front of them, so frees can be subtracted
+static const size_t ALLOCATION_HEADER = alignof(std::max_align_t);
+
+void* operator new(size_t size)
+{
+    char* block = static_cast<char*>(std::malloc(ALLOCATION_HEADER + size));
+    if (!block)
+    {
+        throw std::bad_alloc();
+    }
+    *reinterpret_cast<size_t*>(block) = size;
+    threadHeapBytes += size;
+    return block + ALLOCATION_HEADER;
+}
+
+#if defined(__GNUC__) && __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete" // memory comes from malloc in operator new above
+#endif
+void operator delete(void* memory) noexcept
+{
+    if (!memory)
+    {
+        return;
+    }
+    char* block = static_cast<char*>(memory) - ALLOCATION_HEADER;
+    threadHeapBytes -= *reinterpret_cast<size_t*>(block);
+    std::free(block);
+}
+
+// validation result and load cost of one configuration file
+struct ConfigReport
+{
+    string path;
+    // empty if the file is valid
+    string error;
+    double parseMs;
+    size_t categories;
+    size_t members;
+    size_t duplicateMembers;
+    // values in categories before removing duplicates, per value written in the file
+    double mergeExpansion;
+    // heap bytes of the LayerMap built from the file
+    long long residentBytes;
+};
 
 void logException(const char* filePath, const std::exception& e)
 {
     std::cerr << emojiError << redText << "[ERROR] LayerAlchemy : " << filePath << e.what() << std::endl << endColor;
 }
 
+// the files to validate, directories give their configuration files
+vector<ConfigReport> _reports(const StrVecType& configs)
+{
+    vector<ConfigReport> reports;
+    for (const auto& configPath : configs)
+    {
+        ConfigReport report = ConfigReport();
+        report.path = configPath;
+        // a directory of configuration files is valid too
+        DIR* configDirectory = opendir(configPath.c_str());
+        if (configDirectory)
+        {
+            closedir(configDirectory);
+            for (const auto& filePath : configFilesInDirectory(configPath))
+            {
+                report.path = filePath;
+                reports.push_back(report);
+            }
+            continue;
+        }
+        if (!std::ifstream(configPath))
+        {
+            report.error = " is not a file or a directory";
+        }
+        reports.push_back(report);
+    }
+    return reports;
+}
+
+// loads a file on the calling thread, so its heap bytes are the ones of this file only
+void _profile(ConfigReport& report)
+{
+    ConfigLoadProfile profile = ConfigLoadProfile();
+    auto start = std::chrono::steady_clock::now();
+    ConfigMapType configMap = _streamConfigFromPath(report.path, &profile);
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    report.parseMs = elapsed.count();
+    StrMapType categoryMap = _categoryMapFromConfigMap(configMap);
+    report.categories = categoryMap.size();
+    for (const auto& kvp : categoryMap)
+    {
+        report.members += kvp.second.size();
+    }
+    report.duplicateMembers = profile.duplicateMembers;
+    size_t expandedMembers = profile.literalMembers + profile.mergedMembers;
+    report.mergeExpansion = profile.literalMembers ? double(expandedMembers) / profile.literalMembers : 1.0;
+
+    long long heapBytes = threadHeapBytes;
+    LayerMap layerMap(categoryMap);
+    report.residentBytes = threadHeapBytes - heapBytes;
+}
+
+string _quoted(const string& value)
+{
+    std::ostringstream quoted;
+    quoted << '"';
+    for (unsigned char character : value)
+    {
+        if (character == '"' || character == '\\')
+        {
+            quoted << '\\' << character;
+        }
+        else if (character < 0x20)
+        {
+            quoted << "\\u" << std::hex << std::setw(4) << std::setfill('0') << unsigned(character) << std::dec;
+        }
+        else
+        {
+            quoted << character;
+        }
+    }
+    quoted << '"';
+    return quoted.str();
+}
+
+// {"version": ..., "failures": ..., "configs": [{"path": ..., "valid": ..., "parse_ms": ...}]}
+string _toJson(const vector<ConfigReport>& reports, size_t failures)
+{
+    std::ostringstream json;
+    json << "{\n  \"version\": " << _quoted(LAYER_ALCHEMY_VERSION_STRING) << ",\n"
+         << "  \"failures\": " << failures << ",\n"
+         << "  \"configs\": [";
+    for (size_t index = 0; index < reports.size(); index++)
+    {
+        const ConfigReport& report = reports[index];
+        json << (index ? "," : "") << "\n    {\"path\": " << _quoted(report.path);
+        if (!report.error.empty())
+        {
+            json << ", \"valid\": false, \"error\": " << _quoted(report.error) << "}";
+            continue;
+        }
+        json << ", \"valid\": true"
+             << ", \"parse_ms\": " << report.parseMs
+             << ", \"categories\": " << report.categories
+             << ", \"members\": " << report.members
+             << ", \"duplicate_members\": " << report.duplicateMembers
+             << ", \"merge_expansion\": " << report.mergeExpansion
+             << ", \"resident_bytes\": " << report.residentBytes << "}";
+    }
+    json << "\n  ]\n}\n";
+    return json.str();
+}
+
 int main(int argc, const char* argv[])
 {
     ArgumentParser parser(DESCRIPTION);
-    parser.add_argument("--config", "List of layer names to test", true);
+    parser.add_argument("--config", "List of config files or directories to test", true);
     parser.add_argument("--quiet", "disable terminal output, return code only", false);
+    parser.add_argument("--json", "print the validation and load profile of each file as JSON", false);
 
     try
     {
@@ -57,37 +219,63 @@ int main(int argc, const char* argv[])
 
     auto configs = parser.getv<std::string>("config");
     bool quiet = parser.get<bool>("quiet");
+    bool json = parser.get<bool>("json");
 
-    for(auto it = configs.begin(); it != configs.end(); ++it) 
+    vector<ConfigReport> reports;
+    try
+    {
+        reports = _reports(configs);
+    }
+    catch (const std::exception& e)
     {
-        auto configFilePath = it->c_str();
-        std::ifstream inputFile(configFilePath);
-
-         if (!inputFile || opendir(configFilePath))
-         {
-             if (!quiet)
-             {
-                 logException(configFilePath, std::invalid_argument(" is not a file"));
-             }
-             return 1;
-         }
-        try 
+        if (!quiet)
         {
-            LayerMap testLayerMap = LayerMap(loadConfigToMap(configFilePath));
-            if (!quiet)
-            {
-                std::cout << greenText << emojiOk << "LayerAlchemy : valid configuration file " << configFilePath
-                << std::endl << endColor;
-            }
-        } 
-        catch (const std::exception& e) 
+            logException("", e);
+        }
+        return 1;
+    }
+    // every file is validated, failures don't stop the others
+    parallelFor(reports.size(), [&reports](size_t index) {
+        ConfigReport& report = reports[index];
+        if (!report.error.empty())
+        {
+            return;
+        }
+        try
+        {
+            _profile(report);
+        }
+        catch (const std::exception& e)
+        {
+            report.error = string(" ") + e.what();
+        }
+    }, std::thread::hardware_concurrency());
+
+    size_t failures = 0;
+    for (const auto& report : reports)
+    {
+        failures += !report.error.empty();
+    }
+    if (json)
+    {
+        std::cout << _toJson(reports, failures);
+    }
+    else if (!quiet)
+    {
+        for (const auto& report : reports)
         {
-            if (!quiet)
+            if (!report.error.empty())
             {
-                logException(configFilePath, e);
+                logException(report.path.c_str(), std::runtime_error(report.error));
+                continue;
             }
-            return 1;
+            std::cout << greenText << emojiOk << "LayerAlchemy : valid configuration file " << report.path
+            << std::endl << endColor
+            << "    " << report.parseMs << " ms, " << report.categories << " categories, "
+            << report.members << " members, " << report.duplicateMembers << " duplicate members, "
+            << report.mergeExpansion << "x merge expansion, " << report.residentBytes << " resident bytes"
+            << std::endl;
         }
     }
-    return 0;
+    return failures ? 1 : 0;
 }
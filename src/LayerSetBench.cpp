@@ -0,0 +1,478 @@
+/*
+ * Micro-benchmarks of the core library, results are written as JSON to track regressions between releases
+ * usage example: LayerSetBench --output bench.json
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <random>
+#include <sstream>
+
+#include <unistd.h>
+
+#include "argparse.h"
+
+#include "LayerSetConfig.h"
+#include "LayerSetCore.h"
+#include "LayerSetEmbedded.h"
+#include "version.h"
+
+// every allocation of the process is counted, to report allocations per operation
+static std::atomic<size_t> allocationCount(0);
+
+void* operator new(size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    void* memory = std::malloc(size ? size : 1);
+    if (!memory)
+    {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+#if defined(__GNUC__) && __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete" // memory comes from malloc in operator new above
+#endif
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+static const std::string emojiStopwatch = "\xE2\x8F\xB1 ";
+static const string redText = "\x1B[31m";
+static const string endColor = "\033[0m";
+static const std::string DESCRIPTION = "Simple executable to benchmark the layer categorization";
+static const string LAYER_ALCHEMY_PROJECT_URL = "https://github.com/sebjacob/LayerAlchemy";
+static const std::string HEADER =
+    "\nLayerSetBench " + emojiStopwatch + "\n" + DESCRIPTION +
+    "\n\nLayerAlchemy " + LAYER_ALCHEMY_VERSION_STRING + "\n" +
+     LAYER_ALCHEMY_PROJECT_URL + "\n\n"
+    "Example usage: \n\nLayerSetBench --output bench.json\n"
+    "LayerSetBench --sizes 10 100 1000 --min_time 200";
+
+static const vector<int> DEFAULT_SIZES = {10, 100, 1000, 10000};
+static const int DEFAULT_MIN_TIME = 100; // milliseconds per measure
+
+// written by benchmarks without other side effects, so they are not optimized out
+static volatile size_t benchmarkSink;
+
+struct Measure
+{
+    string name;
+    size_t size;
+    size_t iterations;
+    double nsPerOp;
+    double allocationsPerOp;
+};
+
+// runs an operation until minTime is spent, after a warm up call
+Measure _measure(const string& name, size_t size, double minTime, const std::function<void()>& operation)
+{
+    operation();
+    size_t iterations = 1;
+    while (true)
+    {
+        size_t allocations = allocationCount.load(std::memory_order_relaxed);
+        auto start = std::chrono::steady_clock::now();
+        for (size_t iteration = 0; iteration < iterations; iteration++)
+        {
+            operation();
+        }
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        allocations = allocationCount.load(std::memory_order_relaxed) - allocations;
+        if (elapsed.count() >= minTime * 1e6 || iterations >= (size_t(1) << 30))
+        {
+            Measure measure = {name, size, iterations, elapsed.count() / iterations, double(allocations) / iterations};
+            return measure;
+        }
+        iterations *= 2;
+    }
+}
+
+// synthetic layer names : configured names, prefixed variations and unknown names, in a repeatable random order
+StrVecType _layerNames(const LayerCollection& collection, size_t size)
+{
+    StrVecType knownLayers = collection.layers.uniqueLayers();
+    knownLayers.erase(std::remove_if(knownLayers.begin(), knownLayers.end(), [](const string& layer) {
+        return isLayerPattern(layer);
+    }), knownLayers.end());
+    const StrVecType prefixes = collection.layers["_prefix"];
+    std::mt19937 generator(static_cast<unsigned>(size));
+    std::shuffle(knownLayers.begin(), knownLayers.end(), generator);
+
+    StrVecType layerNames;
+    for (size_t index = 0; layerNames.size() < size; index++)
+    {
+        unsigned kind = generator() % 5;
+        if (kind < 3 && index < knownLayers.size())
+        {
+            layerNames.push_back(knownLayers[index]);
+        }
+        else if (kind == 3 && !prefixes.empty())
+        {
+            layerNames.push_back(prefixes[generator() % prefixes.size()] + "_bench" + std::to_string(index));
+        }
+        else
+        {
+            layerNames.push_back("bench_custom" + std::to_string(index));
+        }
+    }
+    return layerNames;
+}
+
+// a temporary layer config of anchored sets, each one merging an earlier set like the shipped configs do
+string _writeSyntheticConfig(size_t size)
+{
+    char path[] = "/tmp/LayerSetBenchXXXXXX";
+    int descriptor = mkstemp(path);
+    if (descriptor == -1)
+    {
+        throw std::runtime_error("can't create a temporary config file");
+    }
+    close(descriptor);
+    std::ofstream configFile(path);
+    for (size_t index = 0; index < size; index++)
+    {
+        configFile << "category" << index << ": !!set &category" << index << "\n";
+        for (int value = 0; value < 8; value++)
+        {
+            configFile << "  ? layer" << index << "_" << value << "\n";
+        }
+        if (index)
+        {
+            configFile << "  <<: *category" << index / 2 << "\n";
+        }
+    }
+    if (!configFile)
+    {
+        unlink(path);
+        throw std::runtime_error("can't write " + string(path));
+    }
+    return path;
+}
+
+// collects the values of a yaml set node, and of the sets it merges
+void _nodeSetValues(const YAML::Node& node, StrVecType& values)
+{
+    if (node.IsSequence())
+    { // "<<: [*a, *b]" merges several sets
+        for (YAML::const_iterator it = node.begin(); it != node.end(); it++)
+        {
+            _nodeSetValues(*it, values);
+        }
+        return;
+    }
+    if (!node.IsMap())
+    {
+        throw YAML::RepresentationException(node.Mark(), "merged value is not a set");
+    }
+    for (YAML::const_iterator it = node.begin(); it != node.end(); it++)
+    {
+        string value = it->first.as<string>();
+        if (value == "<<")
+        {
+            _nodeSetValues(it->second, values);
+        }
+        else
+        {
+            values.push_back(value);
+        }
+    }
+}
+
+// the loader of the YAML::Node tree replaced by _streamConfigFromPath, kept to compare the two
+size_t _nodeConfigCategories(const string& path)
+{
+    const YAML::Node config = YAML::LoadFile(path);
+    ConfigMapType configMap;
+    for (YAML::const_iterator it = config.begin(); it != config.end(); it++)
+    {
+        ConfigValues& configValues = configMap[it->first.as<string>()];
+        const YAML::Node values = it->second;
+        configValues.isSet = values.IsMap() || values.Tag() == "tag:yaml.org,2002:set";
+        configValues.isRemoval = values.Tag() == REMOVE_TAG;
+        if (values.IsSequence())
+        {
+            configValues.values = values.as<StrVecType>();
+        }
+        else if (values.IsMap())
+        {
+            _nodeSetValues(values, configValues.values);
+            std::sort(configValues.values.begin(), configValues.values.end());
+            configValues.values.erase(std::unique(configValues.values.begin(), configValues.values.end()),
+                                      configValues.values.end());
+        }
+    }
+    return configMap.size();
+}
+
+// public categories used by the filtered benchmarks
+StrVecType _filterCategories(const LayerCollection& collection)
+{
+    StrVecType categories;
+    for (const char* category : {"diffuse", "non_color", "specular"})
+    {
+        if (collection.layers.contains(category))
+        {
+            categories.push_back(category);
+        }
+    }
+    if (categories.empty())
+    {
+        StrVecType publicCategories = collection.layers.categoriesByType(categorizeType::pub);
+        categories.assign(publicCategories.begin(), publicCategories.begin() + std::min<size_t>(2, publicCategories.size()));
+    }
+    return categories;
+}
+
+// expression of the filter categories for the expression benchmarks : "(a | b) & !c"
+string _filterExpression(const StrVecType& categories)
+{
+    string expression;
+    for (size_t index = 0; index + 1 < categories.size(); index++)
+    {
+        expression += (index ? " | " : "(") + categories[index];
+    }
+    if (expression.empty())
+    {
+        return categories.empty() ? "all" : categories.front();
+    }
+    return expression + ") & !" + categories.back();
+}
+
+string _quoted(const string& value)
+{
+    string quoted = "\"";
+    for (char character : value)
+    {
+        if (character == '"' || character == '\\')
+        {
+            quoted += '\\';
+        }
+        quoted += character;
+    }
+    return quoted + "\"";
+}
+
+// {"version": ..., "benchmarks": [{"name": ..., "points": [{"size": ..., "ns_per_op": ...}]}]}, one curve per name
+string _toJson(const vector<Measure>& measures, double minTime)
+{
+    std::ostringstream json;
+    json << "{\n  \"version\": " << _quoted(LAYER_ALCHEMY_VERSION_STRING) << ",\n"
+         << "  \"min_time_ms\": " << minTime << ",\n"
+         << "  \"benchmarks\": [";
+    for (size_t index = 0; index < measures.size(); index++)
+    {
+        const Measure& measure = measures[index];
+        bool newCurve = index == 0 || measures[index - 1].name != measure.name;
+        bool lastPoint = index + 1 == measures.size() || measures[index + 1].name != measure.name;
+        if (newCurve)
+        {
+            json << (index ? "," : "") << "\n    {\"name\": " << _quoted(measure.name) << ", \"points\": [";
+        }
+        json << (newCurve ? "" : ",") << "\n      {\"size\": " << measure.size
+             << ", \"iterations\": " << measure.iterations
+             << ", \"ns_per_op\": " << measure.nsPerOp
+             << ", \"ns_per_item\": " << (measure.size ? measure.nsPerOp / measure.size : measure.nsPerOp)
+             << ", \"allocations_per_op\": " << measure.allocationsPerOp << "}";
+        if (lastPoint)
+        {
+            json << "\n    ]}";
+        }
+    }
+    json << "\n  ]\n}\n";
+    return json.str();
+}
+
+int main(int argc, const char* argv[])
+{
+    // the embedded configurations are used when the environment variables are not set
+    if (!embeddedConfigEnabled() && ((getenv(CHANNEL_ENV_VAR) == NULL) | (getenv(LAYER_ENV_VAR) == NULL)))
+    {
+        std::cerr << HEADER << std::endl;
+        std::cerr << redText << std::endl << "MISSING ENVIRONMENT VARIABLES" << std::endl;
+        std::cerr << std::endl << "The embedded configurations are disabled by " << EMBEDDED_ENV_VAR
+        << ", you need to set environment variables pointing to yaml files for :\n"
+        << std::endl << LAYER_ENV_VAR << std::endl << CHANNEL_ENV_VAR << std::endl << endColor << std::endl;
+        return 1;
+    }
+    ArgumentParser parser(DESCRIPTION);
+    parser.add_argument("--sizes", "Amounts of layer names to benchmark, default 10 100 1000 10000", false);
+    parser.add_argument("--min_time", "Minimum time of each measure in milliseconds, default 100", false);
+    parser.add_argument("--output", "JSON file to write, printed if not set", false);
+
+    try
+    {
+        parser.parse(argc, argv);
+    }
+    catch (const ArgumentParser::ArgumentNotFound &ex)
+    {
+        std::cout << HEADER << std::endl;
+        parser.print_help();
+
+        std::cout << ex.what() << std::endl;
+        return 0;
+    }
+    if (parser.is_help())
+        return 0;
+
+    vector<int> sizes = parser.getv<int>("sizes");
+    if (sizes.empty())
+    {
+        sizes = DEFAULT_SIZES;
+    }
+    double minTime = parser.get<int>("min_time");
+    if (minTime <= 0)
+    {
+        minTime = DEFAULT_MIN_TIME;
+    }
+    string outputPath = parser.get<std::string>("output");
+
+    try
+    {
+        vector<Measure> measures;
+        measures.push_back(_measure("config_load", 0, minTime, []() {
+            LayerCollection layerCollection;
+        }));
+
+        const LayerCollection layerCollection;
+        const StrVecType filterCategories = _filterCategories(layerCollection);
+        const vector<std::pair<string, categorizeType> > catTypes = {
+            {"pub", categorizeType::pub}, {"priv", categorizeType::priv}};
+        const vector<std::pair<string, CategorizeFilter> > filters = {
+            {"include", CategorizeFilter(filterCategories, CategorizeFilter::INCLUDE)},
+            {"exclude", CategorizeFilter(filterCategories, CategorizeFilter::EXCLUDE)},
+            {"only", CategorizeFilter(filterCategories, CategorizeFilter::ONLY)},
+            {"expression", CategorizeFilter(_filterExpression(filterCategories))}};
+        const vector<std::pair<string, topologyStyle> > styles = {
+            {"exr", topologyStyle::exr}, {"lexical", topologyStyle::lexical}};
+
+        // one curve per benchmark, points sorted by size
+        vector<std::pair<string, std::function<void(const StrVecType&, vector<Measure>&, size_t)> > > benchmarks;
+        for (const auto& catType : catTypes)
+        {
+            categorizeType type = catType.second;
+            benchmarks.emplace_back("categorize_" + catType.first,
+                [&layerCollection, type, minTime](const StrVecType& layerNames, vector<Measure>& curve, size_t size) {
+                    curve.push_back(_measure("", size, minTime, [&]() {
+                        LayerMap layerMap = layerCollection.categorizeLayers(layerNames, type);
+                    }));
+                });
+            for (const auto& filter : filters)
+            {
+                const CategorizeFilter& categorizeFilter = filter.second;
+                benchmarks.emplace_back("categorize_" + catType.first + "_" + filter.first,
+                    [&layerCollection, type, categorizeFilter, minTime](const StrVecType& layerNames, vector<Measure>& curve, size_t size) {
+                        curve.push_back(_measure("", size, minTime, [&]() {
+                            LayerMap layerMap = layerCollection.categorizeLayers(layerNames, type, categorizeFilter);
+                        }));
+                    });
+            }
+            benchmarks.emplace_back("categorize_result_" + catType.first,
+                [&layerCollection, type, minTime](const StrVecType& layerNames, vector<Measure>& curve, size_t size) {
+                    CategorizeResult result;
+                    curve.push_back(_measure("", size, minTime, [&]() {
+                        layerCollection.categorizeLayers(layerNames, type, result);
+                    }));
+                });
+            benchmarks.emplace_back("categorize_result_views_" + catType.first,
+                [&layerCollection, type, minTime](const StrVecType& layerNames, vector<Measure>& curve, size_t size) {
+                    CategorizeResult result;
+                    const vector<StrView> layerViews(layerNames.begin(), layerNames.end());
+                    curve.push_back(_measure("", size, minTime, [&]() {
+                        layerCollection.categorizeLayers(spanOf(layerViews), type, result);
+                    }));
+                });
+        }
+        for (const auto& style : styles)
+        {
+            topologyStyle topoStyle = style.second;
+            benchmarks.emplace_back("topology_" + style.first,
+                [&layerCollection, topoStyle, minTime](const StrVecType& layerNames, vector<Measure>& curve, size_t size) {
+                    curve.push_back(_measure("", size, minTime, [&]() {
+                        LayerMap channelMapping = layerCollection.topology(layerNames, topoStyle);
+                    }));
+                });
+        }
+        benchmarks.emplace_back("dePrefix",
+            [&layerCollection, minTime](const StrVecType& layerNames, vector<Measure>& curve, size_t size) {
+                curve.push_back(_measure("", size, minTime, [&]() {
+                    for (const auto& layerName : layerNames)
+                    {
+                        benchmarkSink = layerCollection.dePrefix(StrView(layerName)).size();
+                    }
+                }));
+            });
+        benchmarks.emplace_back("uniqueLayers",
+            [&layerCollection, minTime](const StrVecType& layerNames, vector<Measure>& curve, size_t size) {
+                LayerMap layerMap = layerCollection.categorizeLayers(layerNames, categorizeType::pub);
+                curve.push_back(_measure("", size, minTime, [&]() {
+                    StrVecType uniqueLayers = layerMap.uniqueLayers();
+                }));
+            });
+
+        // the config loaders, size is the amount of categories
+        for (const auto& loader : vector<std::pair<string, std::function<size_t(const string&)> > >{
+                {"config_parse_node", _nodeConfigCategories},
+                {"config_parse_stream", [](const string& path) {
+                    return _streamConfigFromPath(path).size();
+                }}})
+        {
+            for (int size : sizes)
+            {
+                const string configPath = _writeSyntheticConfig(static_cast<size_t>(std::max(size, 1)));
+                measures.push_back(_measure(loader.first, static_cast<size_t>(std::max(size, 1)), minTime, [&]() {
+                    benchmarkSink = loader.second(configPath);
+                }));
+                unlink(configPath.c_str());
+                std::cerr << loader.first << " " << measures.back().size << " : "
+                          << measures.back().nsPerOp << " ns/op" << std::endl;
+            }
+        }
+
+        vector<StrVecType> layerSets;
+        for (int size : sizes)
+        {
+            layerSets.push_back(_layerNames(layerCollection, static_cast<size_t>(std::max(size, 1))));
+        }
+        for (const auto& benchmark : benchmarks)
+        {
+            vector<Measure> curve;
+            for (const auto& layerNames : layerSets)
+            {
+                benchmark.second(layerNames, curve, layerNames.size());
+                curve.back().name = benchmark.first;
+                std::cerr << benchmark.first << " " << layerNames.size() << " : "
+                          << curve.back().nsPerOp << " ns/op" << std::endl;
+            }
+            measures.insert(measures.end(), curve.begin(), curve.end());
+        }
+
+        string json = _toJson(measures, minTime);
+        if (outputPath.empty())
+        {
+            std::cout << json;
+        }
+        else
+        {
+            std::ofstream outputFile(outputPath);
+            if (!(outputFile << json))
+            {
+                throw std::runtime_error("can't write " + outputPath);
+            }
+        }
+        return 0;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "LayerAlchemy ERROR : " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,61 @@
+/*
+ * implementation code for the categorization result cache
+ */
+
+#include "LayerSetCache.h"
+
+LayerMapCache::LayerMapCache(size_t capacity) : m_capacity(capacity), m_hits(0), m_misses(0) {
+}
+
+LayerMapPtr LayerMapCache::find(const string& key) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_lookup.find(key);
+    if (it == m_lookup.end()) {
+        m_misses++;
+        return LayerMapPtr();
+    }
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    m_hits++;
+    return it->second->second;
+}
+
+void LayerMapCache::insert(const string& key, const LayerMapPtr& result) {
+    if (m_capacity == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_lookup.find(key);
+    if (it != m_lookup.end()) { // another thread got there first, keep the stored result
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+        return;
+    }
+    if (m_entries.size() >= m_capacity) {
+        m_lookup.erase(m_entries.back().first);
+        m_entries.pop_back();
+    }
+    m_entries.emplace_front(key, result);
+    m_lookup[key] = m_entries.begin();
+}
+
+void LayerMapCache::clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.clear();
+    m_lookup.clear();
+}
+
+size_t LayerMapCache::size() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_entries.size();
+}
+
+size_t LayerMapCache::capacity() const {
+    return m_capacity;
+}
+
+size_t LayerMapCache::hits() const {
+    return m_hits;
+}
+
+size_t LayerMapCache::misses() const {
+    return m_misses;
+}
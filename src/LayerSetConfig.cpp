@@ -1,25 +1,551 @@
 /* 
  * implementation code focused on configuration file handling
  */
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+#include <dirent.h>
+#include <fnmatch.h>
+#include <sys/stat.h>
+
+#include <yaml-cpp/eventhandler.h>
+
 #include "LayerSetConfig.h"
+#include "LayerSetConfigCache.h"
+#include "LayerSetParallel.h"
+
+static const string MERGE_KEY = "<<";
+static const string SET_TAG = "tag:yaml.org,2002:set";
+
+static bool _isDirectory(const string& path) {
+    struct stat pathStat;
+    return stat(path.c_str(), &pathStat) == 0 && S_ISDIR(pathStat.st_mode);
+}
 
-YAML::Node _loadConfigFromPath(const string& path) {
-    YAML::Node config = YAML::LoadFile(path);
-    return config;
+static void _sortUnique(StrVecType& values) {
+    std::sort(values.begin(), values.end());
+    values.erase(std::unique(values.begin(), values.end()), values.end());
 }
 
-StrMapType _categoryMapFromConfig(const YAML::Node& config) {
+// the values of a category with the values of the categories it merges in the same file, directly or not.
+// Categories without merges keep their values as they are, the others are sorted
+static StrVecType _resolveConfigValues(const ConfigValues& configValues, const ConfigMapType& configMap) {
+    StrVecType values = configValues.values;
+    if (configValues.merges.empty()) {
+        return values;
+    }
+    StrVecType visited;
+    StrVecType pending = configValues.merges;
+    while (!pending.empty()) {
+        string category = std::move(pending.back());
+        pending.pop_back();
+        if (std::find(visited.begin(), visited.end(), category) != visited.end()) {
+            continue;
+        }
+        auto merged = configMap.find(category);
+        visited.push_back(std::move(category));
+        if (merged != configMap.end() && !merged->second.isRemoval) {
+            values.insert(values.end(), merged->second.values.begin(), merged->second.values.end());
+            pending.insert(pending.end(), merged->second.merges.begin(), merged->second.merges.end());
+        }
+    }
+    _sortUnique(values);
+    return values;
+}
+
+StrMapType _categoryMapFromConfigMap(ConfigMapType& configMap) {
     StrMapType categoryMap;
-    for (YAML::const_iterator it = config.begin(); it != config.end(); it++) {
-        string categoryName = it->first.as<string>();
-        StrVecType values = it->second.as<StrVecType>();
-        categoryMap[categoryName] = values;
+    for (auto& kvp : configMap) {
+        if (!kvp.second.isRemoval) {
+            categoryMap[kvp.first].swap(kvp.second.values);
         }
+    }
     return categoryMap;
 }
 
+// what the loader keeps of a yaml node, instead of the node itself
+struct _ConfigNode {
+    enum Kind {null, scalar, sequence, map};
+    Kind kind;
+    // a map, or tagged !!set
+    bool isSet;
+    // tagged REMOVE_TAG
+    bool isRemoval;
+    // scalar : its value, sequence : its scalar items or the values of its sets, map : keys and merged values
+    StrVecType values;
+    // names of the anchored categories merged by a map, or by the sets of a sequence
+    StrVecType merges;
+    // amount of values with the merged categories copied, only counted for a ConfigLoadProfile
+    size_t flatSize;
+    // sequence : all items are scalars, or all items are sets that can be merged
+    bool listable;
+    bool mergeable;
+    YAML::Mark mark;
+    // the values of an anchored category are not copied, they are the ones of the config map
+    const ConfigValues* category;
+    string categoryName;
+    // a map with a bad key or merge, only thrown if the map is used
+    string error;
+    YAML::Mark errorMark;
+    YAML::anchor_t anchor;
+    // map being built : the next node is a key, or the value of a merge key
+    bool expectKey;
+    bool merge;
+
+    _ConfigNode() : kind(null), isSet(false), isRemoval(false), flatSize(0), listable(false), mergeable(false),
+        category(nullptr), anchor(YAML::NullAnchor), expectKey(true), merge(false) {}
+    _ConfigNode(Kind kind, const string& tag, const YAML::Mark& mark, YAML::anchor_t anchor) :
+        kind(kind), isSet(kind == map || tag == SET_TAG), isRemoval(tag == REMOVE_TAG), flatSize(0),
+        listable(kind == sequence), mergeable(kind != scalar), mark(mark), category(nullptr), anchor(anchor),
+        expectKey(true), merge(false) {}
+
+    const StrVecType& allValues() const {
+        return category ? category->values : values;
+    }
+
+    const StrVecType& allMerges() const {
+        return category ? category->merges : merges;
+    }
+};
+
+/**
+ * Builds a ConfigMapType from the parser events, without a YAML::Node tree.
+ *
+ * Values are copied once from the events into the category, only anchored nodes are kept to resolve aliases and "<<" merge keys. A category merging an anchored
+ * category records its name, the merged values are copied once the file is read. A category given again
+ * gets its values copied in the categories that merged it before.
+ */
+class _ConfigEventHandler : public YAML::EventHandler {
+public:
+    _ConfigEventHandler(ConfigMapType& configMap, ConfigLoadProfile* profile) :
+        m_configMap(configMap), m_profile(profile) {}
+
+    void OnDocumentStart(const YAML::Mark&) override {}
+    void OnDocumentEnd() override {}
+
+    void OnNull(const YAML::Mark& mark, YAML::anchor_t anchor) override {
+        if (m_stack.empty()) { // placeholder files
+            return;
+        }
+        // read as a string, a null is "null"
+        _scalar(mark, "", anchor, "null");
+    }
+
+    void OnAlias(const YAML::Mark& mark, YAML::anchor_t anchor) override {
+        // the parser knows the anchor from the start of its node, its values are only kept at the end
+        if (anchor >= m_anchors.size() || m_anchors[anchor].kind == _ConfigNode::null) {
+            throw YAML::RepresentationException(mark, "alias inside its own anchored node");
+        }
+        _ConfigNode& node = m_anchors[anchor];
+        if (node.kind == _ConfigNode::scalar) {
+            _addScalar(node.mark, node.isSet, node.values.front());
+        } else {
+            _addNode(node);
+        }
+    }
+
+    void OnScalar(const YAML::Mark& mark, const string& tag, YAML::anchor_t anchor, const string& value) override {
+        if (m_stack.empty()) {
+            throw YAML::RepresentationException(mark, "config is not a mapping of sets or lists");
+        }
+        _scalar(mark, tag, anchor, value);
+    }
+
+    void OnSequenceStart(const YAML::Mark& mark, const string& tag, YAML::anchor_t anchor,
+                         YAML::EmitterStyle::value) override {
+        if (m_stack.empty()) {
+            throw YAML::RepresentationException(mark, "config is not a mapping of sets or lists");
+        }
+        m_stack.emplace_back(_ConfigNode::sequence, tag, mark, anchor);
+    }
+
+    void OnSequenceEnd() override {
+        _endNode();
+    }
+
+    void OnMapStart(const YAML::Mark& mark, const string& tag, YAML::anchor_t anchor,
+                    YAML::EmitterStyle::value) override {
+        m_stack.emplace_back(_ConfigNode::map, tag, mark, anchor);
+    }
+
+    void OnMapEnd() override {
+        _endNode();
+    }
+
+private:
+    ConfigMapType& m_configMap;
+    // counts of the load, when asked for
+    ConfigLoadProfile* m_profile;
+    // nodes being built, the document map first
+    vector<_ConfigNode> m_stack;
+    // indexed by anchor
+    vector<_ConfigNode> m_anchors;
+    // category of the value being read in the document map
+    string m_category;
+
+    void _keep(const _ConfigNode& node) {
+        if (node.anchor == YAML::NullAnchor) {
+            return;
+        }
+        if (node.anchor >= m_anchors.size()) {
+            m_anchors.resize(node.anchor + 1);
+        }
+        m_anchors[node.anchor] = node;
+    }
+
+    void _scalar(const YAML::Mark& mark, const string& tag, YAML::anchor_t anchor, const string& value) {
+        if (anchor != YAML::NullAnchor) {
+            _ConfigNode node(_ConfigNode::scalar, tag, mark, anchor);
+            node.values.push_back(value);
+            _keep(node);
+        }
+        _addScalar(mark, tag == SET_TAG, value);
+    }
+
+    void _endNode() {
+        _ConfigNode node(std::move(m_stack.back()));
+        m_stack.pop_back();
+        if (m_stack.empty()) { // the document map
+            return;
+        }
+        if (m_stack.size() == 1 && !m_stack.back().expectKey) {
+            m_stack.back().expectKey = true;
+            const ConfigValues& configValues = _addCategory(node, true);
+            node.values.clear();
+            node.merges.clear();
+            node.category = &configValues;
+            node.categoryName = m_category;
+        } else {
+            _addNode(node);
+        }
+        _keep(node);
+    }
+
+    // a category given again changes its values : the anchors using them get a copy first, and the nodes
+    // and categories merging it copy the values it had when they merged it
+    void _detach(const ConfigValues& configValues) {
+        for (auto& node : m_anchors) {
+            if (node.category == &configValues) {
+                if (m_profile) {
+                    node.flatSize = _resolvedSize(configValues);
+                }
+                node.values = configValues.values;
+                node.merges = configValues.merges;
+                node.category = nullptr;
+            } else if (!node.category) {
+                _copyMerged(node.values, node.merges, configValues);
+            }
+        }
+        for (auto& kvp : m_configMap) {
+            if (&kvp.second != &configValues && _copyMerged(kvp.second.values, kvp.second.merges, configValues)) {
+                _sortUnique(kvp.second.values);
+                _sortUnique(kvp.second.merges);
+            }
+        }
+    }
+
+    // replaces the merge of the current category by a copy of its values and merges, false if it isn't merged
+    bool _copyMerged(StrVecType& values, StrVecType& merges, const ConfigValues& configValues) const {
+        auto it = std::find(merges.begin(), merges.end(), m_category);
+        if (it == merges.end()) {
+            return false;
+        }
+        merges.erase(it);
+        values.insert(values.end(), configValues.values.begin(), configValues.values.end());
+        merges.insert(merges.end(), configValues.merges.begin(), configValues.merges.end());
+        return true;
+    }
+
+    ConfigValues& _configValues() {
+        auto inserted = m_configMap.emplace(m_category, ConfigValues());
+        if (!inserted.second) {
+            _detach(inserted.first->second);
+        }
+        return inserted.first->second;
+    }
+
+    size_t _resolvedSize(const ConfigValues& configValues) const {
+        return _resolveConfigValues(configValues, m_configMap).size();
+    }
+
+    // amount of values a node brings when it is merged, as if the categories it merges were copied
+    size_t _flatSize(const _ConfigNode& node) const {
+        return node.category ? _resolvedSize(*node.category) : node.flatSize;
+    }
+
+    static void _setError(_ConfigNode& parent, const YAML::Mark& mark, const string& error) {
+        if (parent.error.empty()) {
+            parent.error = error;
+            parent.errorMark = mark;
+        }
+    }
+
+    static void _throwError(const _ConfigNode& node) {
+        if (!node.error.empty()) {
+            throw YAML::RepresentationException(node.errorMark, node.error);
+        }
+    }
+
+    // merges the values of a set, or of a sequence of sets
+    void _mergeNode(_ConfigNode& parent, const _ConfigNode& node) {
+        if (!node.error.empty()) {
+            _setError(parent, node.errorMark, node.error);
+        } else if (!node.mergeable) {
+            _setError(parent, node.mark, "merged value is not a set");
+        } else {
+            if (m_profile) {
+                size_t flatSize = _flatSize(node);
+                parent.flatSize += flatSize;
+                // "<<: [*a, *b]" counts once, when the set merges the sequence
+                if (parent.kind == _ConfigNode::map) {
+                    m_profile->mergedMembers += flatSize;
+                }
+            }
+            if (node.category && !node.category->isRemoval) {
+                // merged by name, the values stay in the category
+                parent.merges.push_back(node.categoryName);
+            } else {
+                const StrVecType& values = node.allValues();
+                const StrVecType& merges = node.allMerges();
+                parent.values.insert(parent.values.end(), values.begin(), values.end());
+                parent.merges.insert(parent.merges.end(), merges.begin(), merges.end());
+            }
+        }
+    }
+
+    void _countLiteral() {
+        if (m_profile) {
+            m_profile->literalMembers++;
+        }
+    }
+
+    void _addScalar(const YAML::Mark& mark, bool isSet, const string& value) {
+        _ConfigNode& parent = m_stack.back();
+        if (parent.kind == _ConfigNode::sequence) {
+            if (parent.listable) {
+                parent.values.push_back(value);
+                parent.flatSize++;
+                _countLiteral();
+            }
+            parent.mergeable = false;
+            return;
+        }
+        bool isKey = parent.expectKey;
+        parent.expectKey = !isKey;
+        if (m_stack.size() == 1) {
+            if (isKey) {
+                m_category = value;
+                return;
+            }
+            // an empty !!set is an empty scalar
+            if (!isSet) {
+                throw YAML::RepresentationException(mark, "config is not a mapping of sets or lists");
+            }
+            ConfigValues& configValues = _configValues();
+            configValues.isSet = true;
+            configValues.isRemoval = false;
+        } else if (isKey) {
+            parent.merge = value == MERGE_KEY;
+            if (!parent.merge) {
+                parent.values.push_back(value);
+                parent.flatSize++;
+                _countLiteral();
+            }
+        } else if (parent.merge) {
+            _setError(parent, mark, "merged value is not a set");
+        }
+    }
+
+    // adds a sequence or map to its parent
+    void _addNode(_ConfigNode& node) {
+        _ConfigNode& parent = m_stack.back();
+        if (parent.kind == _ConfigNode::sequence) {
+            if (node.mergeable) {
+                _mergeNode(parent, node);
+            } else {
+                parent.mergeable = false;
+            }
+            parent.listable = false;
+            return;
+        }
+        bool isKey = parent.expectKey;
+        parent.expectKey = !isKey;
+        if (isKey) {
+            if (m_stack.size() == 1) {
+                throw YAML::RepresentationException(node.mark, "category name is not a string");
+            }
+            _setError(parent, node.mark, "set value is not a string");
+            parent.merge = false;
+        } else if (m_stack.size() == 1) {
+            _addCategory(node, false);
+        } else if (parent.merge) {
+            _mergeNode(parent, node);
+        }
+    }
+
+    // the values of the node are moved to the category if it is movable, aliases use a copy
+    ConfigValues& _addCategory(_ConfigNode& node, bool movable) {
+        ConfigValues& configValues = _configValues();
+        // values of a category given again, for the duplicates of the profile
+        size_t flatSize = m_profile ? _resolvedSize(configValues) : 0;
+        configValues.isSet = node.isSet;
+        configValues.isRemoval = node.isRemoval;
+        _throwError(node);
+        if (node.kind == _ConfigNode::sequence) {
+            if (!node.listable) {
+                throw YAML::RepresentationException(node.mark, "config is not a mapping of sets or lists");
+            }
+            if (movable) {
+                configValues.values.swap(node.values);
+            } else {
+                configValues.values = node.allValues();
+            }
+            if (m_profile) { // lists keep their duplicates
+                StrVecType sortedValues = configValues.values;
+                std::sort(sortedValues.begin(), sortedValues.end());
+                m_profile->duplicateMembers +=
+                    sortedValues.end() - std::unique(sortedValues.begin(), sortedValues.end());
+            }
+            configValues.merges.clear();
+            return configValues;
+        }
+        const StrVecType& values = node.allValues();
+        const StrVecType& merges = node.allMerges();
+        if (movable && configValues.values.empty()) {
+            configValues.values.swap(node.values);
+        } else {
+            configValues.values.insert(configValues.values.end(), values.begin(), values.end());
+        }
+        configValues.merges.insert(configValues.merges.end(), merges.begin(), merges.end());
+        // a category given again merging itself already has its values
+        configValues.merges.erase(std::remove(configValues.merges.begin(), configValues.merges.end(), m_category),
+                                  configValues.merges.end());
+        _sortUnique(configValues.values);
+        _sortUnique(configValues.merges);
+        if (m_profile) {
+            flatSize += _flatSize(node);
+            m_profile->duplicateMembers += flatSize - _resolvedSize(configValues);
+        }
+        return configValues;
+    }
+};
+
+ConfigMapType _streamConfigFromPath(const string& path, ConfigLoadProfile* profile) {
+    std::ifstream stream(path);
+    if (!stream) {
+        throw std::runtime_error("can't open the configuration file " + path);
+    }
+    ConfigMapType configMap;
+    _ConfigEventHandler handler(configMap, profile);
+    YAML::Parser parser(stream);
+    // only the first document, like YAML::LoadFile
+    parser.HandleNextDocument(handler);
+    // merged values are copied once the file is read, the merges are kept for the hierarchy.
+    // A removal erases the values of the categories it merges too, it has no hierarchy
+    vector<StrVecType> resolved;
+    resolved.reserve(configMap.size());
+    for (const auto& kvp : configMap) {
+        resolved.push_back(_resolveConfigValues(kvp.second, configMap));
+    }
+    size_t index = 0;
+    for (auto& kvp : configMap) {
+        kvp.second.values.swap(resolved[index++]);
+        if (kvp.second.isRemoval) {
+            kvp.second.merges.clear();
+        }
+    }
+    return configMap;
+}
+
+void _mergeConfigValues(ConfigValues& configValues, const ConfigValues& other) {
+    StrVecType& values = configValues.values;
+    if (other.isRemoval) {
+        configValues.merges.clear();
+        StrVecType removed = other.values;
+        std::sort(removed.begin(), removed.end());
+        values.erase(std::remove_if(values.begin(), values.end(), [&removed](const string& value) {
+            return std::binary_search(removed.begin(), removed.end(), value);
+        }), values.end());
+        return;
+    }
+    values.insert(values.end(), other.values.begin(), other.values.end());
+    if (configValues.isSet || other.isSet) {
+        _sortUnique(values);
+    }
+    if (!other.merges.empty()) {
+        configValues.merges.insert(configValues.merges.end(), other.merges.begin(), other.merges.end());
+        _sortUnique(configValues.merges);
+    }
+}
+
+void _mergeConfigMap(ConfigMapType& configMap, const ConfigMapType& other) {
+    for (const auto& kvp : other) {
+        auto it = configMap.find(kvp.first);
+        if (it == configMap.end()) {
+            if (!kvp.second.isRemoval) {
+                configMap.insert(kvp);
+            }
+            continue;
+        }
+        _mergeConfigValues(it->second, kvp.second);
+        if (kvp.second.isRemoval && it->second.values.empty()) {
+            configMap.erase(it);
+        }
+    }
+}
+
+StrVecType configFilesInDirectory(const string& directoryPath) {
+    StrVecType configFiles;
+    DIR* directory = opendir(directoryPath.c_str());
+    if (directory == nullptr) {
+        throw std::runtime_error("can't open the configuration directory " + directoryPath);
+    }
+    while (struct dirent* entry = readdir(directory)) {
+        string filePath = directoryPath + "/" + entry->d_name;
+        if (fnmatch(CONFIG_FILE_PATTERN.c_str(), entry->d_name, FNM_PERIOD) == 0 && !_isDirectory(filePath)) {
+            configFiles.push_back(filePath);
+        }
+    }
+    closedir(directory);
+    std::sort(configFiles.begin(), configFiles.end());
+    return configFiles;
+}
+
+// the compiled image of a configuration file when it is up to date, the parsed file otherwise
+static ConfigMapType _loadConfigFile(const string& path) {
+    ConfigMapType cachedConfigMap;
+    if (loadConfigCache(path, configCachePath(path), cachedConfigMap)) {
+        return cachedConfigMap;
+    }
+    return _streamConfigFromPath(path);
+}
+
+ConfigMapType _loadConfigMaps(const StrVecType& yamlFilePaths) {
+    vector<ConfigMapType> configMaps(yamlFilePaths.size());
+    parallelFor(yamlFilePaths.size(), [&yamlFilePaths, &configMaps](size_t index) {
+        configMaps[index] = _loadConfigFile(yamlFilePaths[index]);
+    });
+    ConfigMapType merged;
+    for (const auto& configMap : configMaps) {
+        _mergeConfigMap(merged, configMap);
+    }
+    return merged;
+}
+
+ConfigMapType _loadConfigMap(const string& path) {
+    if (_isDirectory(path)) {
+        return _loadConfigMaps(configFilesInDirectory(path));
+    }
+    return _loadConfigFile(path);
+}
+
+StrMapType loadConfigsToMap(const StrVecType& yamlFilePaths) {
+    ConfigMapType merged = _loadConfigMaps(yamlFilePaths);
+    return _categoryMapFromConfigMap(merged);
+}
+
 StrMapType loadConfigToMap(const string& yamlFilePath) {
-    const YAML::Node config = _loadConfigFromPath(yamlFilePath);
-    StrMapType categoryMap = _categoryMapFromConfig(config);
-    return categoryMap;
-}
\ No newline at end of file
+    ConfigMapType configMap = _loadConfigMap(yamlFilePath);
+    return _categoryMapFromConfigMap(configMap);
+}
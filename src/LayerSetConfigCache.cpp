@@ -0,0 +1,232 @@
+/*
+ * implementation code for compiled configuration images
+ */
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "LayerSetConfig.h"
+#include "LayerSetConfigCache.h"
+
+static const char CONFIG_CACHE_MAGIC[8] = {'L', 'A', 'Y', 'E', 'R', 'S', 'E', 'T'};
+
+// FNV-1a, fast enough to hash a configuration file on every load
+static uint64_t _checksum(const char* data, size_t size) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static bool _readFile(const string& path, string& contents) {
+    std::ifstream stream(path, std::ios::in | std::ios::binary);
+    if (!stream) {
+        return false;
+    }
+    contents.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+    return true;
+}
+
+template <typename T>
+static void _append(string& buffer, const T& value) {
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+string configCachePath(const string& sourcePath) {
+    return sourcePath + CONFIG_CACHE_EXTENSION;
+}
+
+void writeConfigCache(const ConfigMapType& configMap, const string& sourcePath, const string& cachePath) {
+    string source;
+    if (!_readFile(sourcePath, source)) {
+        throw std::runtime_error("can't read " + sourcePath);
+    }
+    // intern every category and layer name
+    std::unordered_map<string, uint32_t> stringIds;
+    vector<const string*> strings;
+    auto intern = [&stringIds, &strings](const string& name) -> uint32_t {
+        auto it = stringIds.emplace(name, static_cast<uint32_t>(strings.size()));
+        if (it.second) {
+            strings.push_back(&it.first->first);
+        }
+        return it.first->second;
+    };
+    vector<uint32_t> categories;
+    vector<uint32_t> members;
+    vector<uint32_t> merges;
+    for (const auto& kvp : configMap) {
+        const ConfigValues& configValues = kvp.second;
+        uint32_t flags = (configValues.isSet ? CONFIG_CACHE_SET : 0) | (configValues.isRemoval ? CONFIG_CACHE_REMOVAL : 0);
+        categories.push_back(intern(kvp.first));
+        categories.push_back(flags);
+        categories.push_back(static_cast<uint32_t>(members.size()));
+        categories.push_back(static_cast<uint32_t>(configValues.values.size()));
+        categories.push_back(static_cast<uint32_t>(merges.size()));
+        categories.push_back(static_cast<uint32_t>(configValues.merges.size()));
+        for (const auto& layer : configValues.values) {
+            members.push_back(intern(layer));
+        }
+        for (const auto& category : configValues.merges) {
+            merges.push_back(intern(category));
+        }
+    }
+
+    string payload;
+    string characters;
+    for (const auto name : strings) {
+        _append(payload, static_cast<uint32_t>(characters.size()));
+        characters.append(*name);
+        characters.push_back('\0');
+    }
+    _append(payload, static_cast<uint32_t>(characters.size()));
+    payload.append(reinterpret_cast<const char*>(categories.data()), categories.size() * sizeof(uint32_t));
+    payload.append(reinterpret_cast<const char*>(members.data()), members.size() * sizeof(uint32_t));
+    payload.append(reinterpret_cast<const char*>(merges.data()), merges.size() * sizeof(uint32_t));
+    payload.append(characters);
+
+    // value initialized, the padding is written too
+    ConfigCacheHeader header = ConfigCacheHeader();
+    memcpy(header.magic, CONFIG_CACHE_MAGIC, sizeof(header.magic));
+    header.version = CONFIG_CACHE_VERSION;
+    header.stringCount = static_cast<uint32_t>(strings.size());
+    header.categoryCount = static_cast<uint32_t>(configMap.size());
+    header.memberCount = static_cast<uint32_t>(members.size());
+    header.mergeCount = static_cast<uint32_t>(merges.size());
+    header.sourceSize = source.size();
+    header.sourceChecksum = _checksum(source.data(), source.size());
+    header.payloadSize = payload.size();
+    header.payloadChecksum = _checksum(payload.data(), payload.size());
+
+    // write next to the destination then rename, so readers never see a partial image
+    string temporaryPath = cachePath + ".tmp" + std::to_string(getpid());
+    {
+        std::ofstream stream(temporaryPath, std::ios::out | std::ios::binary | std::ios::trunc);
+        stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        stream.write(payload.data(), payload.size());
+        if (!stream) {
+            throw std::runtime_error("can't write " + temporaryPath);
+        }
+    }
+    if (rename(temporaryPath.c_str(), cachePath.c_str()) != 0) {
+        unlink(temporaryPath.c_str());
+        throw std::runtime_error("can't write " + cachePath);
+    }
+}
+
+void compileConfigCache(const string& sourcePath, const string& cachePath) {
+    ConfigMapType configMap = _streamConfigFromPath(sourcePath);
+    writeConfigCache(configMap, sourcePath, cachePath);
+}
+
+// decodes a mapped image, returns false if anything is out of bounds or does not match
+static bool _decodeConfigCache(const char* image, size_t imageSize, const string& source, ConfigMapType& configMap) {
+    if (imageSize < sizeof(ConfigCacheHeader)) {
+        return false;
+    }
+    ConfigCacheHeader header;
+    memcpy(&header, image, sizeof(header));
+    if (memcmp(header.magic, CONFIG_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+            header.version != CONFIG_CACHE_VERSION ||
+            header.payloadSize != imageSize - sizeof(header) ||
+            header.sourceSize != source.size() ||
+            header.sourceChecksum != _checksum(source.data(), source.size())) {
+        return false;
+    }
+    const char* payload = image + sizeof(header);
+    if (header.payloadChecksum != _checksum(payload, header.payloadSize)) {
+        return false;
+    }
+    uint64_t tableSize = (uint64_t(header.stringCount) + 1 + uint64_t(header.categoryCount) * 6 + header.memberCount +
+                          header.mergeCount) * sizeof(uint32_t);
+    if (tableSize > header.payloadSize) {
+        return false;
+    }
+    vector<uint32_t> tables(tableSize / sizeof(uint32_t));
+    memcpy(tables.data(), payload, tableSize);
+    const uint32_t* stringOffsets = tables.data();
+    const uint32_t* categories = stringOffsets + header.stringCount + 1;
+    const uint32_t* members = categories + header.categoryCount * 6;
+    const uint32_t* merges = members + header.memberCount;
+    const char* characters = payload + tableSize;
+    uint64_t charactersSize = header.payloadSize - tableSize;
+    if (stringOffsets[header.stringCount] != charactersSize) {
+        return false;
+    }
+
+    StrVecType strings;
+    strings.reserve(header.stringCount);
+    for (uint32_t id = 0; id < header.stringCount; id++) {
+        if (stringOffsets[id] >= stringOffsets[id + 1]) {
+            return false;
+        }
+        strings.emplace_back(characters + stringOffsets[id], stringOffsets[id + 1] - stringOffsets[id] - 1);
+    }
+    configMap.clear();
+    for (uint32_t category = 0; category < header.categoryCount; category++) {
+        const uint32_t* fields = categories + category * 6;
+        uint32_t nameId = fields[0];
+        uint64_t first = fields[2];
+        uint64_t count = fields[3];
+        uint64_t firstMerge = fields[4];
+        uint64_t mergeCount = fields[5];
+        if (nameId >= header.stringCount || first + count > header.memberCount ||
+                firstMerge + mergeCount > header.mergeCount) {
+            return false;
+        }
+        ConfigValues& configValues = configMap[strings[nameId]];
+        configValues.isSet = (fields[1] & CONFIG_CACHE_SET) != 0;
+        configValues.isRemoval = (fields[1] & CONFIG_CACHE_REMOVAL) != 0;
+        configValues.values.reserve(count);
+        for (uint64_t member = first; member < first + count; member++) {
+            if (members[member] >= header.stringCount) {
+                return false;
+            }
+            configValues.values.push_back(strings[members[member]]);
+        }
+        for (uint64_t merge = firstMerge; merge < firstMerge + mergeCount; merge++) {
+            if (merges[merge] >= header.stringCount) {
+                return false;
+            }
+            configValues.merges.push_back(strings[merges[merge]]);
+        }
+    }
+    return true;
+}
+
+bool loadConfigCache(const string& sourcePath, const string& cachePath, ConfigMapType& configMap) {
+    string source;
+    if (!_readFile(sourcePath, source)) {
+        return false;
+    }
+    int fileDescriptor = open(cachePath.c_str(), O_RDONLY);
+    if (fileDescriptor < 0) {
+        return false;
+    }
+    struct stat cacheStat;
+    if (fstat(fileDescriptor, &cacheStat) != 0 || cacheStat.st_size <= 0) {
+        close(fileDescriptor);
+        return false;
+    }
+    size_t imageSize = static_cast<size_t>(cacheStat.st_size);
+    void* image = mmap(nullptr, imageSize, PROT_READ, MAP_SHARED, fileDescriptor, 0);
+    close(fileDescriptor);
+    if (image == MAP_FAILED) {
+        return false;
+    }
+    ConfigMapType decoded;
+    bool valid = _decodeConfigCache(static_cast<const char*>(image), imageSize, source, decoded);
+    munmap(image, imageSize);
+    if (valid) {
+        configMap.swap(decoded);
+    }
+    return valid;
+}
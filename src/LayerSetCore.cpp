@@ -4,106 +4,202 @@
 
 #include <iostream>
 #include <algorithm>
+#include <cctype>
+#include <iterator>
+#include <stdexcept>
 
 #include "LayerSetCore.h"
+#include "LayerSetEmbedded.h"
+#include "LayerSetParallel.h"
+#include "LayerSetStats.h"
 
-LayerMap::LayerMap() {
-};
+static const StrVecType NO_LAYERS;
+
+CategoryIterator::CategoryIterator(StrMapType::const_iterator first, StrMapType::const_iterator last, categorizeType catType)
+: m_current(first), m_end(last), m_catType(catType) {
+    _skip();
+}
+
+void CategoryIterator::_skip() {
+    while ((m_current != m_end) && ((m_current->first.find("_") == 0) != (m_catType == categorizeType::priv))) {
+        m_current++;
+    }
+}
+
+CategoryIterator& CategoryIterator::operator++() {
+    m_current++;
+    _skip();
+    return *this;
+}
+
+CategoryIterator CategoryIterator::operator++(int) {
+    CategoryIterator previous = *this;
+    ++(*this);
+    return previous;
+}
+
+UniqueLayerIterator::UniqueLayerIterator(StrMapType::const_iterator first, StrMapType::const_iterator last)
+: m_category(first), m_end(last), m_member(0), m_seen(first != last ? std::make_shared<SeenType>() : nullptr) {
+    _skip();
+}
+
+void UniqueLayerIterator::_skip() {
+    while (m_category != m_end) {
+        if (m_member >= m_category->second.size()) {
+            m_category++;
+            m_member = 0;
+        } else if (!m_seen->insert(&m_category->second[m_member]).second) {
+            m_member++;
+        } else {
+            return;
+        }
+    }
+    m_member = 0;
+}
 
-LayerMap::LayerMap(const LayerMap& other)
-: strMap(other.strMap) {
+UniqueLayerIterator& UniqueLayerIterator::operator++() {
+    m_member++;
+    _skip();
+    return *this;
 }
 
+bool UniqueLayerIterator::operator==(const UniqueLayerIterator& other) const {
+    return (m_category == other.m_category) && (m_member == other.m_member);
+}
+
+LayerMap::LayerMap() {
+};
+
 LayerMap::LayerMap(const StrMapType& other)
-: strMap(other) {
+: m_strMap(other) {
+    _reindex();
 }
 
 LayerMap::~LayerMap() {
 }
 
-LayerMap::LayerMap(const string& yamlFilePath) : strMap(loadConfigToMap(yamlFilePath)) {
+LayerMap::LayerMap(const string& yamlFilePath) : m_strMap(loadConfigToMap(yamlFilePath)) {
+    _reindex();
+}
+
+void LayerMap::_reindex() {
+    m_sortedMembers.clear();
+    for (const auto& kvp : m_strMap) {
+        _indexCategory(kvp.first, kvp.second);
+    }
+}
+
+void LayerMap::_indexCategory(const string& categoryName, const StrVecType& layers) {
+    StrVecType& sortedMembers = m_sortedMembers[categoryName];
+    sortedMembers = layers;
+    std::sort(sortedMembers.begin(), sortedMembers.end());
+    sortedMembers.erase(std::unique(sortedMembers.begin(), sortedMembers.end()), sortedMembers.end());
+}
+
+const StrMapType& LayerMap::strMap() const {
+    return m_strMap;
 }
 
 StrVecType LayerMap::operator[](const StrVecType& categoryNames) const {
     StrVecType items;
     for (auto it = categoryNames.begin(); it != categoryNames.end(); it++) {
-        if (strMap.find(*it) != strMap.end()) {
-            StrVecType categories = strMap.at(*it);
-            if (categories.size() != 0) {
-                for (auto it2 = categories.begin(); it2 != categories.end(); it2++) {
-                    items.push_back(*it2);
-                }
-            }
-        }
+        const StrVecType& layers = members(*it);
+        items.insert(items.end(), layers.begin(), layers.end());
     }
     return items;
 }
 
 StrVecType LayerMap::operator[](const string& categoryName) const {
-    if (strMap.find(categoryName) != strMap.end()) {
-        return strMap.at(categoryName);
-    } else {
-        return StrVecType();
-    }
+    return members(categoryName);
+}
+
+const StrVecType& LayerMap::members(const string& categoryName) const {
+    auto it = m_strMap.find(categoryName);
+    return it != m_strMap.end() ? it->second : NO_LAYERS;
+}
+
+RangeView<CategoryIterator> LayerMap::categoriesView() const {
+    return categoriesView(categorizeType::pub);
+}
+
+RangeView<CategoryIterator> LayerMap::categoriesView(const categorizeType& catType) const {
+    return RangeView<CategoryIterator>(
+        CategoryIterator(m_strMap.begin(), m_strMap.end(), catType), CategoryIterator(m_strMap.end(), m_strMap.end(), catType));
+}
+
+UniqueLayersView LayerMap::uniqueLayersView() const {
+    return UniqueLayersView(m_strMap.begin(), m_strMap.end());
 }
 
 bool LayerMap::isMember(const string& categoryName, const string& layer) const {
-    auto it = strMap.find(categoryName);
-    if (it != strMap.end()) {
-        return find(begin(it->second), end(it->second), layer) != it->second.end();
-    } else {
+    auto it = m_sortedMembers.find(categoryName);
+    if (it == m_sortedMembers.end()) {
         return false;
     }
+    return std::binary_search(it->second.begin(), it->second.end(), layer);
 }
 
 void LayerMap::add(const string categoryName, const string layer) {
-    if (strMap.count(categoryName)) {
-        if (!isMember(categoryName, layer)) {
-            strMap[categoryName].emplace_back(layer);
-        }
-    } else {
-        strMap[categoryName].emplace_back(layer);
+    StrVecType& sortedMembers = m_sortedMembers[categoryName];
+    auto position = std::lower_bound(sortedMembers.begin(), sortedMembers.end(), layer);
+    if (position != sortedMembers.end() && *position == layer) {
+        return;
     }
+    sortedMembers.insert(position, layer);
+    m_strMap[categoryName].emplace_back(layer);
 }
 
-const StrVecType LayerMap::categories() const {
-    StrVecType itemKeys;
-    itemKeys.reserve(strMap.size());
-    for (auto& kvp : strMap) {
-        if (kvp.first.find("_") != 0) {
-            itemKeys.emplace_back(kvp.first);
-        }
+void LayerMap::remove(const string& categoryName, const string& layer) {
+    auto it = m_sortedMembers.find(categoryName);
+    if (it == m_sortedMembers.end()) {
+        return;
     }
-    return itemKeys;
+    StrVecType& sortedMembers = it->second;
+    auto position = std::lower_bound(sortedMembers.begin(), sortedMembers.end(), layer);
+    if (position == sortedMembers.end() || *position != layer) {
+        return;
+    }
+    auto category = m_strMap.find(categoryName);
+    StrVecType& layers = category->second;
+    layers.erase(std::remove(layers.begin(), layers.end(), layer), layers.end());
+    if (layers.empty()) {
+        m_strMap.erase(category);
+        m_sortedMembers.erase(it);
+        return;
+    }
+    sortedMembers.erase(position);
+}
+
+void LayerMap::set(const string& categoryName, const StrVecType& layers) {
+    m_strMap[categoryName] = layers;
+    _indexCategory(categoryName, layers);
 }
 
-const StrVecType LayerMap::categories(string& layerName) const {
+const StrVecType LayerMap::categories() const {
+    RangeView<CategoryIterator> categoryNames = categoriesView();
+    return StrVecType(categoryNames.begin(), categoryNames.end());
+}
+
+const StrVecType LayerMap::categories(const string& layerName) const {
     StrVecType itemKeys;
-    for (auto& kvp : strMap) {
+    for (auto& kvp : m_strMap) {
         if (isMember(kvp.first, layerName)) {
-            itemKeys.emplace_back(layerName);
+            itemKeys.emplace_back(kvp.first);
         }
     }
     return itemKeys;
 }
 const StrVecType LayerMap::uniqueLayers() const {
-    StrVecType uniqueLayers;
-    for (auto & kvp : strMap) {
-        for (auto layer : kvp.second) {
-            if (!(find(begin(uniqueLayers), end(uniqueLayers), layer) != uniqueLayers.end())) {
-                uniqueLayers.push_back(layer);
-            }
-        }
-    }
-    return uniqueLayers;
+    UniqueLayersView layers = uniqueLayersView();
+    return StrVecType(layers.begin(), layers.end());
 }
 
 string LayerMap::toString() const {
     std::ostringstream reprStream;
     string repr;
     reprStream <<
-    "<LayerSetCore.LayerMap object at " << &strMap << "> \n\n{\n";
-    for (auto & kvp : strMap) {
+    "<LayerSetCore.LayerMap object at " << &m_strMap << "> \n\n{\n";
+    for (auto & kvp : m_strMap) {
         reprStream << "'" << (string) kvp.first << "'" << " : (";
         for (unsigned m = 0; m < kvp.second.size(); m++) {
             reprStream << "'" << (string) kvp.second[m] << "'" << ", ";
@@ -115,27 +211,16 @@ string LayerMap::toString() const {
     return repr;
 }
 bool LayerMap::empty() const {
-    return strMap.empty();
+    return m_strMap.empty();
 }
 
 int LayerMap::size() const {
-    return strMap.size();
+    return m_strMap.size();
 }
 
 const StrVecType LayerMap::categoriesByType(const categorizeType& catType) const {
-    StrVecType relevantCats;
-    relevantCats.reserve(strMap.size());
-    for (const auto& kvp : strMap) {
-        int firstToken = kvp.first.find("_");
-        if ((firstToken == 0) && (catType == categorizeType::priv)) { // looking for categories starting with _ in priv mode
-            relevantCats.emplace_back(kvp.first);
-        } else {
-            if ((firstToken != 0) && (catType == categorizeType::pub)) {
-                relevantCats.emplace_back(kvp.first);
-            }
-        }
-    };
-    return relevantCats;
+    RangeView<CategoryIterator> relevantCats = categoriesView(catType);
+    return StrVecType(relevantCats.begin(), relevantCats.end());
 };
 
 CategorizeFilter::CategorizeFilter() {
@@ -147,46 +232,440 @@ CategorizeFilter::CategorizeFilter(const StrVecType& selectedCategories, int mod
     categories = selectedCategories;
 }
 
+/**
+ * Recursive descent parser of CategorizeFilter expressions, writing their postfix instructions :
+ * expression := term ("|" term)*, term := factor ("&" factor)*, factor := "!" factor | "(" expression ")" | name
+ */
+class _FilterParser {
+public:
+    explicit _FilterParser(CategorizeFilter& filter) : m_filter(filter), m_position(0), m_nesting(0), m_depth(0) {
+    }
+
+    void parse() {
+        _expression();
+        if (_peek()) {
+            _error("unexpected character");
+        }
+    }
+
+private:
+    // next character after white space, 0 at the end
+    char _peek() {
+        const string& text = m_filter.expression;
+        while (m_position < text.size() && std::isspace(static_cast<unsigned char>(text[m_position]))) {
+            m_position++;
+        }
+        return m_position < text.size() ? text[m_position] : 0;
+    }
+
+    void _error(const string& message) const {
+        throw std::invalid_argument("invalid category expression '" + m_filter.expression + "' : " + message +
+                                    " at position " + std::to_string(m_position));
+    }
+
+    // adds an instruction, tracking the booleans a FilterProgram will have on its stack
+    void _emit(FilterProgram::OpCode code, size_t category = 0) {
+        if (code == FilterProgram::OP_ANY) {
+            m_depth++;
+        } else if (code != FilterProgram::OP_NOT) {
+            m_depth--;
+        }
+        if (m_depth > FilterProgram::MAX_DEPTH) {
+            _error("expression is too deep");
+        }
+        m_filter.program.emplace_back(code, category);
+    }
+
+    void _expression() {
+        _term();
+        while (_peek() == '|') {
+            m_position++;
+            _term();
+            _emit(FilterProgram::OP_OR);
+        }
+    }
+
+    void _term() {
+        _factor();
+        while (_peek() == '&') {
+            m_position++;
+            _factor();
+            _emit(FilterProgram::OP_AND);
+        }
+    }
+
+    void _factor() {
+        char character = _peek();
+        if (character == '!' || character == '(') {
+            if (++m_nesting > FilterProgram::MAX_DEPTH) {
+                _error("expression is too deep");
+            }
+            m_position++;
+            if (character == '!') {
+                _factor();
+                _emit(FilterProgram::OP_NOT);
+            } else {
+                _expression();
+                if (_peek() != ')') {
+                    _error("expected ')'");
+                }
+                m_position++;
+            }
+            m_nesting--;
+            return;
+        }
+        const string& text = m_filter.expression;
+        size_t start = m_position;
+        while (m_position < text.size() && !std::isspace(static_cast<unsigned char>(text[m_position])) &&
+               string("()|&!").find(text[m_position]) == string::npos) {
+            m_position++;
+        }
+        if (m_position == start) {
+            _error("expected a category name");
+        }
+        string name = text.substr(start, m_position - start);
+        StrVecType& categories = m_filter.categories;
+        size_t category = std::find(categories.begin(), categories.end(), name) - categories.begin();
+        if (category == categories.size()) {
+            categories.push_back(name);
+        }
+        _emit(FilterProgram::OP_ANY, category);
+    }
+
+    CategorizeFilter& m_filter;
+    size_t m_position;
+    // parentheses and negations around the current factor
+    size_t m_nesting;
+    size_t m_depth;
+};
+
+CategorizeFilter::CategorizeFilter(const string& filterExpression) {
+    filterMode = CategorizeFilter::modes::EXPRESSION;
+    expression = filterExpression;
+    _FilterParser(*this).parse();
+}
+
+// loads a channel configuration, counted in the statistics
+static StrMapType _loadConfig(const string& configPath) {
+    stats::ScopedTimer timer(stats::configLoadTime, stats::configLoads);
+    return loadConfigToMap(configPath);
+}
+
+static StrMapType _loadConfigs(const StrVecType& configPaths) {
+    stats::ScopedTimer timer(stats::configLoadTime, stats::configLoads);
+    return loadConfigsToMap(configPaths);
+}
+
+// loads a layer configuration, the categories keep the names of the categories they merge for the LayerIndex
+static ConfigMapType _loadLayerConfig(const string& configPath) {
+    stats::ScopedTimer timer(stats::configLoadTime, stats::configLoads);
+    return _loadConfigMap(configPath);
+}
+
+static ConfigMapType _loadLayerConfigs(const StrVecType& configPaths) {
+    stats::ScopedTimer timer(stats::configLoadTime, stats::configLoads);
+    return _loadConfigMaps(configPaths);
+}
+
+// the embedded layer configuration, its categories are sets without merges
+static ConfigMapType _embeddedLayerConfigMap() {
+    ConfigMapType configMap;
+    for (auto& kvp : embeddedConfigToMap(embeddedLayerConfig())) {
+        ConfigValues configValues = {std::move(kvp.second), StrVecType(), true, false};
+        configMap.emplace_hint(configMap.end(), kvp.first, std::move(configValues));
+    }
+    return configMap;
+}
+
+// a channel configuration file on top of the embedded one, the file alone if the embedded configurations are disabled
+static StrMapType _loadChannelsOverEmbedded(const string& configPath) {
+    if (!embeddedConfigEnabled()) {
+        return _loadConfig(configPath);
+    }
+    return overlayEmbeddedConfig(embeddedChannelConfig(), _loadConfig(configPath), false);
+}
+
+// a layer configuration file on top of the embedded one, its values are merged in the embedded sets
+// like overlayEmbeddedConfig, and its removals are ignored
+static ConfigMapType _loadLayersOverEmbedded(const string& configPath) {
+    if (!embeddedConfigEnabled()) {
+        return _loadLayerConfig(configPath);
+    }
+    ConfigMapType overlay = _loadLayerConfig(configPath);
+    ConfigMapType configMap = _embeddedLayerConfigMap();
+    for (auto& kvp : overlay) {
+        if (kvp.second.isRemoval) {
+            continue;
+        }
+        auto it = configMap.find(kvp.first);
+        if (it == configMap.end()) {
+            configMap.emplace(kvp.first, std::move(kvp.second));
+        } else {
+            _mergeConfigValues(it->second, kvp.second);
+        }
+    }
+    return configMap;
+}
+
+// the configuration file set by an environment variable, nullptr to use the embedded configuration alone
+static const char* _defaultConfigPath(const char* envVar) {
+    const char* configPath = getenv(envVar);
+    if (!configPath && !embeddedConfigEnabled()) {
+        throw std::invalid_argument(string(envVar) + " is not set, and the embedded configurations are disabled");
+    }
+    return configPath;
+}
+
+// the configuration of an environment variable over the embedded one, or the embedded configuration alone
+static StrMapType _defaultChannelConfig() {
+    const char* configPath = _defaultConfigPath(CHANNEL_ENV_VAR);
+    if (configPath) {
+        return _loadChannelsOverEmbedded(configPath);
+    }
+    stats::ScopedTimer timer(stats::configLoadTime, stats::configLoads);
+    return embeddedConfigToMap(embeddedChannelConfig());
+}
+
+static ConfigMapType _defaultLayerConfig() {
+    const char* configPath = _defaultConfigPath(LAYER_ENV_VAR);
+    if (configPath) {
+        return _loadLayersOverEmbedded(configPath);
+    }
+    stats::ScopedTimer timer(stats::configLoadTime, stats::configLoads);
+    return _embeddedLayerConfigMap();
+}
+
 LayerCollection::LayerCollection() :
-channels(LayerMap(loadConfigToMap((getenv(CHANNEL_ENV_VAR))))),
-layers(LayerMap(loadConfigToMap((getenv(LAYER_ENV_VAR))))) {
+m_categorizeCache(CATEGORIZE_CACHE_CAPACITY),
+m_generation(0),
+channels(LayerMap(_defaultChannelConfig())) {
+    _buildIndex(_defaultLayerConfig());
+}
+
+LayerCollection::LayerCollection(const string& layerConfigPath, const string& channelConfigPath, unsigned long generation,
+                                 bool overEmbedded) :
+m_categorizeCache(CATEGORIZE_CACHE_CAPACITY),
+m_generation(generation),
+channels(LayerMap(overEmbedded ? _loadChannelsOverEmbedded(channelConfigPath) : _loadConfig(channelConfigPath))) {
+    _buildIndex(overEmbedded ? _loadLayersOverEmbedded(layerConfigPath) : _loadLayerConfig(layerConfigPath));
+}
+
+LayerCollection::LayerCollection(const StrVecType& layerConfigPaths, const StrVecType& channelConfigPaths, unsigned long generation) :
+m_categorizeCache(CATEGORIZE_CACHE_CAPACITY),
+m_generation(generation),
+channels(LayerMap(_loadConfigs(channelConfigPaths))) {
+    _buildIndex(_loadLayerConfigs(layerConfigPaths));
+}
+
+LayerCollection::LayerCollection(const ConfigStack& layerStack, const ConfigStack& channelStack, unsigned long generation) :
+m_categorizeCache(CATEGORIZE_CACHE_CAPACITY),
+m_generation(generation),
+channels(LayerMap(channelStack.toMap())) {
+    _buildIndex(layerStack.toConfigMap());
+}
+
+unsigned long LayerCollection::generation() const {
+    return m_generation;
 }
 
 LayerCollection::~LayerCollection() {
 }
 
-string LayerCollection::dePrefix(const string layerName) const {
-    string unPrefixedLayerName, outputLayerName;
-    StrVecType prefix = layers.strMap.at("_prefix");
+void LayerCollection::_buildIndex(ConfigMapType layerConfig) {
+    m_layerIndex = LayerIndex(layerConfig);
+    layers = LayerMap(_categoryMapFromConfigMap(layerConfig));
+    m_prefixMatcher = PrefixMatcher(layers["_prefix"]);
+    m_publicCategories = CategoryBitset(m_layerIndex.categoryCount());
+    m_privateCategories = CategoryBitset(m_layerIndex.categoryCount());
+    for (IdType categoryId = 0; categoryId < m_layerIndex.categoryCount(); categoryId++) {
+        if (m_layerIndex.isPrivate(categoryId)) {
+            m_privateCategories.set(categoryId);
+        } else {
+            m_publicCategories.set(categoryId);
+        }
+    }
+    // in the channel config file, naming is defined by _vec4_exr _vec4
+    const string defaultCategory = "_vec4";
+    const string exrToken = "_exr";
+    const StrVecType topoNames = channels[TOPOLOGY_KEY_LEXICAL]; // all styles derived from lexical
+    vector<StrVecType> lexicalChannels, exrChannels;
+    for (auto iterCategory = topoNames.begin(); iterCategory != topoNames.end(); iterCategory++) {
+        lexicalChannels.push_back(channels[*iterCategory]);
+        exrChannels.push_back(channels[*iterCategory + exrToken]);
+    }
+    m_topologies[static_cast<int>(topologyStyle::lexical)] = TopologyTable(
+        m_layerIndex, topoNames, lexicalChannels, channels[defaultCategory]);
+    m_topologies[static_cast<int>(topologyStyle::exr)] = TopologyTable(
+        m_layerIndex, topoNames, exrChannels, channels[defaultCategory + exrToken]);
+}
 
-    for (StrVecType::const_iterator iterPrefix = prefix.begin(); iterPrefix != prefix.end(); iterPrefix++) {
-        string prefixName = *iterPrefix;
-        string prefixToFind = prefixName + "_";
-        size_t prefixLocation = layerName.rfind(prefixToFind);
-        string pos = layerName.substr(0, prefixLocation);
-        if ((prefixLocation != string::npos) || (layerName.substr(0, prefixToFind.length()) == prefixToFind)) {
-            unPrefixedLayerName = prefixName;
+const CategoryBitset& LayerCollection::_categoryMaskByType(const categorizeType& catType) const {
+    return catType == categorizeType::priv ? m_privateCategories : m_publicCategories;
+}
+
+size_t LayerCollection::_categoryLists(const StrView& layerName, bool dePrefixedOnly, const vector<IdType>* lists[4]) const {
+    size_t count = 0;
+    StrView dePrefixedName = dePrefix(layerName);
+    if (!dePrefixedOnly) {
+        lists[count++] = &m_layerIndex.categoriesOf(m_layerIndex.layerId(layerName));
+    }
+    lists[count++] = &m_layerIndex.categoriesOf(m_layerIndex.layerId(dePrefixedName));
+    if (m_layerIndex.hasPatterns()) { // exact names are the common case, patterns are only run when configured
+        if (!dePrefixedOnly) {
+            lists[count++] = &m_layerIndex.patternCategoriesOf(layerName);
         }
+        lists[count++] = &m_layerIndex.patternCategoriesOf(dePrefixedName);
+    }
+    return count;
+}
+
+void LayerCollection::_layerCategoryIds(const StrView& layerName, bool dePrefixedOnly, vector<IdType>& categoryIds) const {
+    const vector<IdType>* lists[4];
+    size_t count = _categoryLists(layerName, dePrefixedOnly, lists);
+    categoryIds.clear();
+    for (size_t index = 0; index < count; index++) {
+        categoryIds.insert(categoryIds.end(), lists[index]->begin(), lists[index]->end());
+    }
+    if (count > 1) {
+        std::sort(categoryIds.begin(), categoryIds.end());
+        categoryIds.erase(std::unique(categoryIds.begin(), categoryIds.end()), categoryIds.end());
     }
-    return (unPrefixedLayerName.length() > 0) ? unPrefixedLayerName : layerName;
+}
+
+const CategoryBitset& LayerCollection::_compileFilter(const CategorizeFilter& catFilter, const categorizeType& catType, FilterProgram& program, CategoryBitset& foundCats) const {
+    const CategoryBitset& typeCats = _categoryMaskByType(catType);
+    program.clear(m_layerIndex.categoryCount());
+    if (catFilter.filterMode == CategorizeFilter::EXPRESSION) {
+        vector<IdType> categoryIds;
+        categoryIds.reserve(catFilter.categories.size());
+        for (const auto& category : catFilter.categories) {
+            categoryIds.push_back(m_layerIndex.categoryId(category));
+        }
+        for (const auto& instruction : catFilter.program) {
+            if (instruction.first != FilterProgram::OP_ANY) {
+                program.push(instruction.first);
+                continue;
+            }
+            // unknown categories have no layers
+            CategoryBitset& mask = program.pushAny();
+            if (instruction.second < categoryIds.size() && categoryIds[instruction.second] != INVALID_ID) {
+                mask.set(categoryIds[instruction.second]);
+            }
+        }
+        return typeCats;
+    }
+    if (catFilter.filterMode == CategorizeFilter::ONLY) {
+        // every layer is kept, in the requested categories only
+        program.push(FilterProgram::OP_TRUE);
+        foundCats.resize(m_layerIndex.categoryCount());
+        foundCats.reset();
+        for (auto iterCat = catFilter.categories.begin(); iterCat != catFilter.categories.end(); iterCat++) {
+            IdType categoryId = m_layerIndex.categoryId(*iterCat);
+            if (categoryId != INVALID_ID && typeCats.test(categoryId)) {
+                foundCats.set(categoryId);
+            }
+        }
+        return foundCats;
+    }
+    CategoryBitset& filterCats = program.pushAny();
+    //loop over the requested categories, make sure they are found in the LayerCollection object
+    for (auto iterCat = catFilter.categories.begin(); iterCat != catFilter.categories.end(); iterCat++) {
+        IdType categoryId = m_layerIndex.categoryId(*iterCat);
+        if (categoryId != INVALID_ID) {
+            filterCats.set(categoryId);
+        }
+    }
+    if (catFilter.filterMode == CategorizeFilter::EXCLUDE) {
+        program.push(FilterProgram::OP_NOT);
+    }
+    return typeCats;
+}
+
+StrVecType LayerCollection::categoriesOf(const StrView& layerName) const {
+    const vector<IdType>& exactIds = m_layerIndex.categoriesOf(m_layerIndex.layerId(layerName));
+    const vector<IdType>& patternIds = m_layerIndex.patternCategoriesOf(layerName);
+    vector<IdType> categoryIds;
+    std::set_union(exactIds.begin(), exactIds.end(), patternIds.begin(), patternIds.end(),
+                   std::back_inserter(categoryIds));
+    StrVecType categoryNames;
+    categoryNames.reserve(categoryIds.size());
+    for (auto categoryId : categoryIds) {
+        categoryNames.emplace_back(m_layerIndex.categoryName(categoryId));
+    }
+    return categoryNames;
+}
+
+StrVecType LayerCollection::categoriesOf(const StrView& layerName, const categorizeType& catType) const {
+    const CategoryBitset& relevantCats = _categoryMaskByType(catType);
+    vector<IdType> categoryIds;
+    _layerCategoryIds(layerName, false, categoryIds);
+    StrVecType categoryNames;
+    IdType previousId = INVALID_ID;
+    for (auto categoryId : categoryIds) { // sorted, a category can be found by several names
+        if (categoryId != previousId && relevantCats.test(categoryId)) {
+            categoryNames.emplace_back(m_layerIndex.categoryName(categoryId));
+        }
+        previousId = categoryId;
+    }
+    return categoryNames;
+}
+
+bool LayerCollection::isMember(const StrView& categoryName, const StrView& layerName) const {
+    IdType categoryId = m_layerIndex.categoryId(categoryName);
+    if (categoryId == INVALID_ID) {
+        return false;
+    }
+    if (m_layerIndex.isMember(categoryId, m_layerIndex.layerId(layerName))) {
+        return true;
+    }
+    const vector<IdType>& patternIds = m_layerIndex.patternCategoriesOf(layerName);
+    return std::binary_search(patternIds.begin(), patternIds.end(), categoryId);
+}
+
+bool LayerCollection::isSubcategory(const StrView& categoryName, const StrView& subcategoryName) const {
+    return m_layerIndex.isSubcategory(m_layerIndex.categoryId(categoryName), m_layerIndex.categoryId(subcategoryName));
+}
+
+StrVecType LayerCollection::subcategories(const StrView& categoryName) const {
+    StrVecType subcategoryNames;
+    for (auto subcategoryId : m_layerIndex.directSubcategoriesOf(m_layerIndex.categoryId(categoryName))) {
+        subcategoryNames.emplace_back(m_layerIndex.categoryName(subcategoryId));
+    }
+    return subcategoryNames;
+}
+
+const string& LayerCollection::dePrefix(const string& layerName) const {
+    int prefixPosition = m_prefixMatcher.match(layerName);
+    return (prefixPosition != -1) ? m_prefixMatcher.prefix(prefixPosition) : layerName;
+}
+
+StrView LayerCollection::dePrefix(const StrView& layerName) const {
+    int prefixPosition = m_prefixMatcher.match(layerName);
+    return (prefixPosition != -1) ? StrView(m_prefixMatcher.prefix(prefixPosition)) : layerName;
 }
 
 bool LayerMap::contains(const string& categoryName) const {
-    StrVecType categories = this->categories();
-    bool result = std::any_of(categories.begin(), categories.end(), [categoryName](const string & str) {
-        return str == categoryName; });
-    return result;
+    // private categories are not listed by categories()
+    return (categoryName.find("_") != 0) && (m_strMap.find(categoryName) != m_strMap.end());
 }
 
 bool LayerMap::contains(const StrVecType& categoryNames) const {
-    StrVecType categories = this->categories();
-    return std::includes(categories.begin(), categories.end(), categoryNames.begin(), categoryNames.end());
+    for (auto iterCat = categoryNames.begin(); iterCat != categoryNames.end(); iterCat++) {
+        if (!contains(*iterCat)) {
+            return false;
+        }
+    }
+    return true;
 }
 
 string utilities::getLayerFromChannel(const string& layerName) {
     return layerName.substr(0, layerName.find("."));
 };
 
+StrView utilities::getLayerViewFromChannel(const StrView& layerName) {
+    return layerName.substr(0, layerName.find('.'));
+}
+
 StrVecType utilities::applyChannelNames(const string& layerName, const StrVecType& topologyVector) {
     StrVecType channelNames;
     channelNames.reserve(topologyVector.size());
@@ -197,18 +676,21 @@ StrVecType utilities::applyChannelNames(const string& layerName, const StrVecTyp
 }
 
 LayerMap LayerCollection::categorizeLayers(const StrVecType& layersToCategorize, const categorizeType& catType) const {
+    stats::ScopedTimer timer(stats::categorizeTime, stats::categorizeCalls);
+    stats::add(stats::layersCategorized, layersToCategorize.size());
+    stats::add(stats::layerMapsBuilt);
     LayerMap categorizedLayerMap;
-    StrVecType relevantCats = layers.categoriesByType(catType);
+    const CategoryBitset& relevantCats = _categoryMaskByType(catType);
+    vector<IdType> layerCats;
 
     for (StrVecType::const_iterator iterLayer = layersToCategorize.begin(); iterLayer != layersToCategorize.end(); iterLayer++) {
-        string realLayerName;
         string layerName = utilities::getLayerFromChannel(*iterLayer);
-        string dePrefixedLayerName = dePrefix(layerName);
         categorizedLayerMap.add("all", layerName);
+        _layerCategoryIds(layerName, false, layerCats);
 
-        for (StrVecType::const_iterator iterCat = relevantCats.begin(); iterCat != relevantCats.end(); iterCat++) {
-            if (layers.isMember(*iterCat, dePrefixedLayerName) | layers.isMember(*iterCat, layerName)) {
-                categorizedLayerMap.add(*iterCat, layerName);
+        for (auto iterCat = layerCats.begin(); iterCat != layerCats.end(); iterCat++) {
+            if (relevantCats.test(*iterCat)) {
+                categorizedLayerMap.add(m_layerIndex.categoryName(*iterCat), layerName);
             }
         }
     }
@@ -216,76 +698,292 @@ LayerMap LayerCollection::categorizeLayers(const StrVecType& layersToCategorize,
 };
 
 LayerMap LayerCollection::categorizeLayers(const StrVecType& layersToCategorize, const categorizeType& catType, const CategorizeFilter& catFilter) const {
+    stats::ScopedTimer timer(stats::categorizeTime, stats::categorizeCalls);
+    stats::add(stats::layersCategorized, layersToCategorize.size());
+    stats::add(stats::layerMapsBuilt);
     LayerMap categorizedLayerMap;
-    StrVecType foundCats;
-    StrVecType relevantCats = layers.categoriesByType(catType);
-    //loop over the requested categories, make sure they are found in the LayerCollection object
-    for (auto iterCat = catFilter.categories.begin(); iterCat != catFilter.categories.end(); iterCat++) {
-        bool found = std::find(relevantCats.begin(), relevantCats.end(), *iterCat) != relevantCats.end();
-        if (found) {
-            foundCats.push_back(*iterCat);
-        }
-    }
-    if (catFilter.filterMode == CategorizeFilter::ONLY) { // constrain categories for ONLY
-        relevantCats = foundCats;
-    }
+    FilterProgram program;
+    CategoryBitset foundCats;
+    vector<IdType> layerCats;
+    const CategoryBitset& relevantCats = _compileFilter(catFilter, catType, program, foundCats);
+    const bool addToAll = catFilter.filterMode != CategorizeFilter::ONLY;
 
     for (auto iterLayer = layersToCategorize.begin(); iterLayer != layersToCategorize.end(); iterLayer++) {
         string layerName = utilities::getLayerFromChannel(*iterLayer);
-        string dePrefixedLayerName = dePrefix(layerName);
-        bool validLayer = false;
-        for (auto iterFilter = catFilter.categories.begin(); iterFilter != catFilter.categories.end(); iterFilter++) {
-            if (layers.isMember(*iterFilter, dePrefixedLayerName)) {
-                validLayer = true;
+        _layerCategoryIds(layerName, true, layerCats);
+        if (!program.evaluate(layerCats)) {
+            continue;
+        }
+        for (auto iterCat = layerCats.begin(); iterCat != layerCats.end(); iterCat++) {
+            if (relevantCats.test(*iterCat)) {
+                if (addToAll) {
+                    categorizedLayerMap.add("all", layerName);
+                }
+                categorizedLayerMap.add(m_layerIndex.categoryName(*iterCat), layerName);
             }
         }
+    }
+    return categorizedLayerMap;
+};
+
+void LayerCollection::categorizeLayers(const StrVecType& layersToCategorize, const categorizeType& catType, CategorizeResult& result) const {
+    stats::ScopedTimer timer(stats::categorizeTime, stats::categorizeCalls);
+    stats::add(stats::layersCategorized, layersToCategorize.size());
+    result._start(layersToCategorize, m_layerIndex);
+    _categorizeResult(catType, nullptr, result);
+}
+
+void LayerCollection::categorizeLayers(const StrVecType& layersToCategorize, const categorizeType& catType, const CategorizeFilter& catFilter, CategorizeResult& result) const {
+    stats::ScopedTimer timer(stats::categorizeTime, stats::categorizeCalls);
+    stats::add(stats::layersCategorized, layersToCategorize.size());
+    result._start(layersToCategorize, m_layerIndex);
+    _categorizeResult(catType, &catFilter, result);
+}
 
-        if ((validLayer & (catFilter.filterMode != CategorizeFilter::EXCLUDE)) ||
-                (!validLayer & (catFilter.filterMode != CategorizeFilter::INCLUDE))) {
+void LayerCollection::categorizeLayers(const StrViewSpan& layersToCategorize, const categorizeType& catType, CategorizeResult& result) const {
+    stats::ScopedTimer timer(stats::categorizeTime, stats::categorizeCalls);
+    stats::add(stats::layersCategorized, layersToCategorize.size());
+    result._start(layersToCategorize, m_layerIndex);
+    _categorizeResult(catType, nullptr, result);
+}
 
-            for (auto iterCat = relevantCats.begin(); iterCat != relevantCats.end(); iterCat++) {
+void LayerCollection::categorizeLayers(const StrViewSpan& layersToCategorize, const categorizeType& catType, const CategorizeFilter& catFilter, CategorizeResult& result) const {
+    stats::ScopedTimer timer(stats::categorizeTime, stats::categorizeCalls);
+    stats::add(stats::layersCategorized, layersToCategorize.size());
+    result._start(layersToCategorize, m_layerIndex);
+    _categorizeResult(catType, &catFilter, result);
+}
 
-                if (layers.isMember(*iterCat, dePrefixedLayerName)) {
-                    if (catFilter.filterMode != CategorizeFilter::ONLY) {
-                        categorizedLayerMap.add("all", layerName);
-                    }
-                    categorizedLayerMap.add(*iterCat, layerName);
+LayerMap LayerCollection::categorizeLayers(const StrViewSpan& layersToCategorize, const categorizeType& catType) const {
+    CategorizeResult result;
+    categorizeLayers(layersToCategorize, catType, result);
+    return result.toLayerMap();
+}
+
+LayerMap LayerCollection::categorizeLayers(const StrViewSpan& layersToCategorize, const categorizeType& catType, const CategorizeFilter& catFilter) const {
+    CategorizeResult result;
+    categorizeLayers(layersToCategorize, catType, catFilter, result);
+    return result.toLayerMap();
+}
+
+void LayerCollection::_categorizeResult(const categorizeType& catType, const CategorizeFilter* catFilter, CategorizeResult& result) const {
+    vector<IdType>& layerCats = result.m_layerCategories;
+    const CategoryBitset& relevantCats = catFilter ?
+        _compileFilter(*catFilter, catType, result.m_filterProgram, result.m_foundCategories) : _categoryMaskByType(catType);
+    const bool addToAll = !catFilter || catFilter->filterMode != CategorizeFilter::ONLY;
+
+    for (unsigned layer = 0; layer < result.m_layers.size(); layer++) {
+        if (!catFilter) {
+            result._addToAll(layer);
+        }
+        // filters only use the de-prefixed name, like the LayerMap version
+        _layerCategoryIds(result.m_layers[layer], catFilter != nullptr, layerCats);
+        if (catFilter && !result.m_filterProgram.evaluate(layerCats)) {
+            continue;
+        }
+        for (auto iterCat = layerCats.begin(); iterCat != layerCats.end(); iterCat++) {
+            if (relevantCats.test(*iterCat)) {
+                if (addToAll) {
+                    result._addToAll(layer);
                 }
+                result._add(*iterCat, layer);
             }
         }
     }
-    return categorizedLayerMap;
-};
-
-LayerMap LayerCollection::topology(const StrVecType& layerNames, const topologyStyle& style) const {
-    // in the channel config file, naming is defined by _vec4_exr _vec4
-    const string defaultCategory =  "_vec4";
-    const string exrToken = "_exr";
-    const string defaultTopology = style == topologyStyle::exr ? defaultCategory + exrToken : defaultCategory;
-    const StrVecType defaultChannels = channels[defaultTopology];
+    result._build(m_layerIndex);
+}
 
-    const StrVecType topoNames = channels[TOPOLOGY_KEY_LEXICAL]; // all styles derived from lexical
+void LayerCollection::updateCategorizedLayers(LayerMap& categorized, const StrVecType& addedLayers, const StrVecType& removedLayers, const categorizeType& catType) const {
+    stats::ScopedTimer timer(stats::categorizeTime, stats::categorizeCalls);
+    stats::add(stats::layersCategorized, addedLayers.size() + removedLayers.size());
+    const CategoryBitset& relevantCats = _categoryMaskByType(catType);
+    vector<IdType> layerCats;
+
+    for (const auto& removedLayer : removedLayers) {
+        string layerName = utilities::getLayerFromChannel(removedLayer);
+        categorized.remove("all", layerName);
+        _layerCategoryIds(layerName, false, layerCats);
+        for (auto categoryId : layerCats) {
+            if (relevantCats.test(categoryId)) {
+                categorized.remove(m_layerIndex.categoryName(categoryId), layerName);
+            }
+        }
+    }
+    for (const auto& addedLayer : addedLayers) {
+        string layerName = utilities::getLayerFromChannel(addedLayer);
+        categorized.add("all", layerName);
+        _layerCategoryIds(layerName, false, layerCats);
+        for (auto categoryId : layerCats) {
+            if (relevantCats.test(categoryId)) {
+                categorized.add(m_layerIndex.categoryName(categoryId), layerName);
+            }
+        }
+    }
+}
 
-    LayerMap channelMapping;
-    LayerMap categorized = categorizeLayers(layerNames, categorizeType::priv);
+void LayerCollection::updateCategorizedLayers(LayerMap& categorized, const StrVecType& addedLayers, const StrVecType& removedLayers, const categorizeType& catType, const CategorizeFilter& catFilter) const {
+    stats::ScopedTimer timer(stats::categorizeTime, stats::categorizeCalls);
+    stats::add(stats::layersCategorized, addedLayers.size() + removedLayers.size());
+    FilterProgram program;
+    CategoryBitset foundCats;
+    vector<IdType> layerCats;
+    const CategoryBitset& relevantCats = _compileFilter(catFilter, catType, program, foundCats);
+    const bool addToAll = catFilter.filterMode != CategorizeFilter::ONLY;
+
+    // a removed layer is in none of its categories if the filter rejected it, removing it is then a no-op
+    for (const auto& removedLayer : removedLayers) {
+        string layerName = utilities::getLayerFromChannel(removedLayer);
+        categorized.remove("all", layerName);
+        _layerCategoryIds(layerName, true, layerCats);
+        for (auto categoryId : layerCats) {
+            if (relevantCats.test(categoryId)) {
+                categorized.remove(m_layerIndex.categoryName(categoryId), layerName);
+            }
+        }
+    }
+    for (const auto& addedLayer : addedLayers) {
+        string layerName = utilities::getLayerFromChannel(addedLayer);
+        _layerCategoryIds(layerName, true, layerCats);
+        if (!program.evaluate(layerCats)) {
+            continue;
+        }
+        for (auto categoryId : layerCats) {
+            if (relevantCats.test(categoryId)) {
+                if (addToAll) {
+                    categorized.add("all", layerName);
+                }
+                categorized.add(m_layerIndex.categoryName(categoryId), layerName);
+            }
+        }
+    }
+}
 
-    for (auto iterCategory = topoNames.begin(); iterCategory != topoNames.end(); iterCategory++) {
-        if (!categorized.contains(*iterCategory)) {
-            string _topoType = style == topologyStyle::exr ? *iterCategory + exrToken : *iterCategory;
-            StrVecType channelNames = channels[_topoType]; // look up channel names for this type
-            StrVecType categorizedLayers = categorized[*iterCategory];
-            for (auto iterLayer = categorizedLayers.begin(); iterLayer != categorizedLayers.end(); iterLayer++) {
-                channelMapping.strMap[*iterLayer] =  utilities::applyChannelNames(*iterLayer, channelNames);
+// layer lists categorized by one task, so short lists don't spend their time on scheduling
+static const size_t BATCH_CHUNK_SIZE = 16;
+
+vector<LayerMap> LayerCollection::_categorizeBatch(const vector<StrVecType>& layerLists, const categorizeType& catType, const CategorizeFilter* catFilter) const {
+    vector<LayerMap> layerMaps(layerLists.size());
+    size_t chunkCount = (layerLists.size() + BATCH_CHUNK_SIZE - 1) / BATCH_CHUNK_SIZE;
+    parallelFor(chunkCount, [&](size_t chunk) {
+        CategorizeResult result;
+        size_t last = std::min(layerLists.size(), (chunk + 1) * BATCH_CHUNK_SIZE);
+        for (size_t index = chunk * BATCH_CHUNK_SIZE; index < last; index++) {
+            if (catFilter) {
+                categorizeLayers(layerLists[index], catType, *catFilter, result);
+            } else {
+                categorizeLayers(layerLists[index], catType, result);
             }
+            layerMaps[index] = result.toLayerMap();
+        }
+    }, std::thread::hardware_concurrency());
+    return layerMaps;
+}
+
+vector<LayerMap> LayerCollection::categorizeLayers(const vector<StrVecType>& layerLists, const categorizeType& catType) const {
+    return _categorizeBatch(layerLists, catType, nullptr);
+}
+
+vector<LayerMap> LayerCollection::categorizeLayers(const vector<StrVecType>& layerLists, const categorizeType& catType, const CategorizeFilter& catFilter) const {
+    return _categorizeBatch(layerLists, catType, &catFilter);
+}
+
+StrVecType LayerCollection::_cacheKey(const StrVecType& layersToCategorize, const categorizeType& catType, const CategorizeFilter* catFilter, string& key) const {
+    StrVecType layerNames;
+    layerNames.reserve(layersToCategorize.size());
+    for (auto iterLayer = layersToCategorize.begin(); iterLayer != layersToCategorize.end(); iterLayer++) {
+        layerNames.emplace_back(utilities::getLayerFromChannel(*iterLayer));
+    }
+    std::sort(layerNames.begin(), layerNames.end());
+    layerNames.erase(std::unique(layerNames.begin(), layerNames.end()), layerNames.end());
+
+    // names can't contain line breaks, so they separate the fields
+    key = catType == categorizeType::priv ? "priv\n" : "pub\n";
+    if (catFilter) {
+        key += "filter " + std::to_string(catFilter->filterMode) + " " + std::to_string(catFilter->categories.size()) + "\n";
+        for (auto iterCat = catFilter->categories.begin(); iterCat != catFilter->categories.end(); iterCat++) {
+            key += *iterCat + "\n";
+        }
+        for (const auto& instruction : catFilter->program) {
+            key += std::to_string(instruction.first) + " " + std::to_string(instruction.second) + "\n";
         }
     }
-    // this is for layers that are were not classified, make them RGBA
+    key += "\n";
+    for (auto iterLayer = layerNames.begin(); iterLayer != layerNames.end(); iterLayer++) {
+        key += *iterLayer + "\n";
+    }
+    return layerNames;
+}
+
+LayerMapPtr LayerCollection::cachedCategorizeLayers(const StrVecType& layersToCategorize, const categorizeType& catType) const {
+    string key;
+    StrVecType layerNames = _cacheKey(layersToCategorize, catType, nullptr, key);
+    LayerMapPtr categorized = m_categorizeCache.find(key);
+    stats::add(categorized ? stats::cacheHits : stats::cacheMisses);
+    if (!categorized) {
+        categorized = std::make_shared<const LayerMap>(categorizeLayers(layerNames, catType));
+        m_categorizeCache.insert(key, categorized);
+    }
+    return categorized;
+}
+
+LayerMapPtr LayerCollection::cachedCategorizeLayers(const StrVecType& layersToCategorize, const categorizeType& catType, const CategorizeFilter& catFilter) const {
+    string key;
+    StrVecType layerNames = _cacheKey(layersToCategorize, catType, &catFilter, key);
+    LayerMapPtr categorized = m_categorizeCache.find(key);
+    stats::add(categorized ? stats::cacheHits : stats::cacheMisses);
+    if (!categorized) {
+        categorized = std::make_shared<const LayerMap>(categorizeLayers(layerNames, catType, catFilter));
+        m_categorizeCache.insert(key, categorized);
+    }
+    return categorized;
+}
+
+const LayerMapCache& LayerCollection::categorizeCache() const {
+    return m_categorizeCache;
+}
+
+LayerMap LayerCollection::topology(const StrVecType& layerNames, const topologyStyle& style) const {
+    stats::ScopedTimer timer(stats::topologyTime, stats::topologyCalls);
+    stats::add(stats::layerMapsBuilt);
+    LayerMap channelMapping;
     for (auto iterLayer = layerNames.begin(); iterLayer != layerNames.end(); iterLayer++) {
         // in case channel names are used, get the layer name
         string layerName = utilities::getLayerFromChannel(*iterLayer);
-        if (!channelMapping.contains(layerName)) {
-            channelMapping.strMap[layerName] = utilities::applyChannelNames(layerName, defaultChannels);
-        }
+        channelMapping.set(layerName, utilities::applyChannelNames(layerName, topologyChannels(layerName, style)));
     }
     return channelMapping;
 };
+
+size_t LayerCollection::topology(const StrVecType& layerNames, const topologyStyle& style, ChannelNameBuffer& channelNames) const {
+    stats::ScopedTimer timer(stats::topologyTime, stats::topologyCalls);
+    size_t written = 0;
+    for (auto iterLayer = layerNames.begin(); iterLayer != layerNames.end(); iterLayer++) {
+        StrView layerName = utilities::getLayerViewFromChannel(*iterLayer);
+        written += channelNames.append(layerName, topologyChannels(layerName, style));
+    }
+    return written;
+}
+
+size_t LayerCollection::topology(const StrViewSpan& layerNames, const topologyStyle& style, ChannelNameBuffer& channelNames) const {
+    stats::ScopedTimer timer(stats::topologyTime, stats::topologyCalls);
+    size_t written = 0;
+    for (const auto& channelName : layerNames) {
+        StrView layerName = utilities::getLayerViewFromChannel(channelName);
+        written += channelNames.append(layerName, topologyChannels(layerName, style));
+    }
+    return written;
+}
+
+const StrVecType& LayerCollection::topologyChannels(const StrView& layerName, const topologyStyle& style) const {
+    // layers that are not classified are RGBA
+    const TopologyTable& table = m_topologies[static_cast<int>(style)];
+    const vector<IdType>* lists[4];
+    size_t count = _categoryLists(layerName, false, lists);
+    int position = -1;
+    for (size_t index = 0; index < count; index++) {
+        for (auto iterCat = lists[index]->begin(); iterCat != lists[index]->end(); iterCat++) {
+            position = std::max(position, table.position(*iterCat));
+        }
+    }
+    return table.channels(position);
+}
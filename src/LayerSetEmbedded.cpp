@@ -0,0 +1,69 @@
+/*
+ * implementation code for the embedded default configurations
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "LayerSetEmbedded.h"
+// generated at build time from the shipped configurations
+#include "LayerSetEmbeddedConfig.h"
+
+bool embeddedConfigEnabled() {
+    const char* enabled = getenv(EMBEDDED_ENV_VAR);
+    return !enabled || strcmp(enabled, "0") != 0;
+}
+
+const EmbeddedConfig& embeddedLayerConfig() {
+    return EMBEDDED_LAYER_CONFIG;
+}
+
+const EmbeddedConfig& embeddedChannelConfig() {
+    return EMBEDDED_CHANNEL_CONFIG;
+}
+
+static StrVecType _embeddedValues(const EmbeddedConfig& config, unsigned index) {
+    const EmbeddedCategory& category = config.categories[index];
+    return StrVecType(config.values + category.first, config.values + category.first + category.count);
+}
+
+StrMapType embeddedConfigToMap(const EmbeddedConfig& config) {
+    StrMapType categoryMap;
+    for (unsigned index = 0; index < config.categoryCount; index++) {
+        const EmbeddedCategory& category = config.categories[index];
+        // categories are sorted, each one is inserted at the end of the map
+        categoryMap.emplace_hint(categoryMap.end(), string(category.name, category.size), _embeddedValues(config, index));
+    }
+    return categoryMap;
+}
+
+StrMapType overlayEmbeddedConfig(const EmbeddedConfig& config, const StrMapType& overlay, bool mergeValues) {
+    StrMapType categoryMap;
+    vector<bool> overlaid(config.categoryCount, false);
+    for (const auto& kvp : overlay) {
+        int index = embeddedCategoryIndex(config, kvp.first.data(), kvp.first.size());
+        StrVecType values;
+        if (index != -1) {
+            overlaid[index] = true;
+        }
+        if (index != -1 && mergeValues) {
+            // same as merging configuration files, see loadConfigsToMap
+            values = _embeddedValues(config, index);
+            values.insert(values.end(), kvp.second.begin(), kvp.second.end());
+            std::sort(values.begin(), values.end());
+            values.erase(std::unique(values.begin(), values.end()), values.end());
+        } else {
+            values = kvp.second;
+        }
+        // the overlay is sorted, each category is inserted at the end of the map
+        categoryMap.emplace_hint(categoryMap.end(), kvp.first, std::move(values));
+    }
+    for (unsigned index = 0; index < config.categoryCount; index++) {
+        if (!overlaid[index]) {
+            const EmbeddedCategory& category = config.categories[index];
+            categoryMap.emplace(string(category.name, category.size), _embeddedValues(config, index));
+        }
+    }
+    return categoryMap;
+}
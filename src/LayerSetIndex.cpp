@@ -0,0 +1,675 @@
+/*
+ * implementation code for the interned name tables and membership bitsets
+ */
+
+#include <algorithm>
+#include <bitset>
+#include <queue>
+#include <stdexcept>
+
+#include "LayerSetIndex.h"
+
+static const size_t BITS_PER_WORD = 64;
+static const int ALPHABET_SIZE = 256;
+static const vector<IdType> NO_CATEGORIES;
+
+CategoryBitset::CategoryBitset() : m_size(0) {
+}
+
+CategoryBitset::CategoryBitset(size_t size) : m_words((size + BITS_PER_WORD - 1) / BITS_PER_WORD, 0), m_size(size) {
+}
+
+void CategoryBitset::resize(size_t size) {
+    m_words.resize((size + BITS_PER_WORD - 1) / BITS_PER_WORD, 0);
+    m_size = size;
+}
+
+void CategoryBitset::reset() {
+    std::fill(m_words.begin(), m_words.end(), 0);
+}
+
+void CategoryBitset::set(size_t bit) {
+    m_words[bit / BITS_PER_WORD] |= uint64_t(1) << (bit % BITS_PER_WORD);
+}
+
+void CategoryBitset::unset(size_t bit) {
+    m_words[bit / BITS_PER_WORD] &= ~(uint64_t(1) << (bit % BITS_PER_WORD));
+}
+
+bool CategoryBitset::test(size_t bit) const {
+    return (m_words[bit / BITS_PER_WORD] >> (bit % BITS_PER_WORD)) & 1;
+}
+
+bool CategoryBitset::any() const {
+    for (auto word : m_words) {
+        if (word) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t CategoryBitset::count() const {
+    size_t total = 0;
+    for (auto word : m_words) {
+        total += std::bitset<BITS_PER_WORD>(word).count();
+    }
+    return total;
+}
+
+bool CategoryBitset::isSubsetOf(const CategoryBitset& other) const {
+    for (size_t i = 0; i < m_words.size(); i++) {
+        uint64_t otherWord = i < other.m_words.size() ? other.m_words[i] : 0;
+        if (m_words[i] & ~otherWord) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CategoryBitset::intersects(const CategoryBitset& other) const {
+    size_t wordCount = std::min(m_words.size(), other.m_words.size());
+    for (size_t i = 0; i < wordCount; i++) {
+        if (m_words[i] & other.m_words[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t CategoryBitset::size() const {
+    return m_size;
+}
+
+CategoryBitset& CategoryBitset::operator|=(const CategoryBitset& other) {
+    if (other.m_size > m_size) {
+        resize(other.m_size);
+    }
+    for (size_t i = 0; i < other.m_words.size(); i++) {
+        m_words[i] |= other.m_words[i];
+    }
+    return *this;
+}
+
+CategoryBitset& CategoryBitset::operator&=(const CategoryBitset& other) {
+    for (size_t i = 0; i < m_words.size(); i++) {
+        m_words[i] &= i < other.m_words.size() ? other.m_words[i] : 0;
+    }
+    return *this;
+}
+
+FilterProgram::FilterProgram() : m_maskCount(0), m_categoryCount(0), m_depth(0) {
+}
+
+void FilterProgram::clear(size_t categoryCount) {
+    m_instructions.clear();
+    m_maskCount = 0;
+    m_categoryCount = categoryCount;
+    m_depth = 0;
+    m_layerCategories.resize(categoryCount);
+}
+
+CategoryBitset& FilterProgram::pushAny() {
+    if (m_depth == MAX_DEPTH) {
+        throw std::invalid_argument("filter program is too deep");
+    }
+    if (m_maskCount == m_masks.size()) {
+        m_masks.emplace_back();
+    }
+    CategoryBitset& mask = m_masks[m_maskCount];
+    mask.resize(m_categoryCount);
+    mask.reset();
+    m_instructions.push_back({OP_ANY, static_cast<unsigned>(m_maskCount++)});
+    m_depth++;
+    return mask;
+}
+
+void FilterProgram::push(OpCode code) {
+    size_t operands = code == OP_NOT ? 1 : (code == OP_AND || code == OP_OR) ? 2 : 0;
+    if (m_depth < operands || (code == OP_TRUE && m_depth == MAX_DEPTH) || code == OP_ANY) {
+        throw std::invalid_argument("invalid filter program instruction");
+    }
+    size_t size = m_instructions.size();
+    // "a | b" on two leaves is a single leaf, with the categories of both
+    if (code == OP_OR && m_instructions[size - 1].code == OP_ANY && m_instructions[size - 2].code == OP_ANY) {
+        m_masks[m_instructions[size - 2].mask] |= m_masks[m_instructions[size - 1].mask];
+        m_instructions.pop_back();
+        m_maskCount--;
+        m_depth--;
+        return;
+    }
+    m_instructions.push_back({code, 0});
+    m_depth = m_depth + (code == OP_TRUE) - (operands == 2);
+}
+
+bool FilterProgram::evaluate(const vector<IdType>& categoryIds) {
+    for (auto categoryId : categoryIds) {
+        m_layerCategories.set(categoryId);
+    }
+    // the top of the stack is the lowest bit
+    uint64_t stack = 0;
+    for (const auto& instruction : m_instructions) {
+        switch (instruction.code) {
+            case OP_ANY:
+                stack = (stack << 1) | m_layerCategories.intersects(m_masks[instruction.mask]);
+                break;
+            case OP_NOT:
+                stack ^= 1;
+                break;
+            case OP_AND:
+                stack = (stack >> 1) & (stack | ~uint64_t(1));
+                break;
+            case OP_OR:
+                stack = (stack >> 1) | (stack & 1);
+                break;
+            case OP_TRUE:
+                stack = (stack << 1) | 1;
+                break;
+        }
+    }
+    for (auto categoryId : categoryIds) {
+        m_layerCategories.unset(categoryId);
+    }
+    return stack & 1;
+}
+
+size_t FilterProgram::size() const {
+    return m_instructions.size();
+}
+
+StringTable::StringTable() {
+}
+
+StringTable::StringTable(const StringTable& other) {
+    *this = other;
+}
+
+StringTable& StringTable::operator=(const StringTable& other) {
+    if (this != &other) {
+        m_ids.clear();
+        m_names.clear();
+        for (const auto& name : other.m_names) {
+            intern(name);
+        }
+    }
+    return *this;
+}
+
+IdType StringTable::intern(const string& name) {
+    auto it = m_ids.find(name);
+    if (it != m_ids.end()) {
+        return it->second;
+    }
+    IdType id = static_cast<IdType>(m_names.size());
+    m_names.push_back(name);
+    m_ids.emplace(m_names.back(), id);
+    return id;
+}
+
+IdType StringTable::find(const StrView& name) const {
+    auto it = m_ids.find(name);
+    return it != m_ids.end() ? it->second : INVALID_ID;
+}
+
+const string& StringTable::name(IdType id) const {
+    return m_names[id];
+}
+
+size_t StringTable::size() const {
+    return m_names.size();
+}
+
+PrefixMatcher::PrefixMatcher() : m_transitions(ALPHABET_SIZE, 0), m_matches(1, -1) {
+}
+
+PrefixMatcher::PrefixMatcher(const StrVecType& prefixes) : m_prefixes(prefixes), m_transitions(ALPHABET_SIZE, -1), m_matches(1, -1) {
+    // trie of the prefixes followed by their separator
+    for (size_t position = 0; position < m_prefixes.size(); position++) {
+        string pattern = m_prefixes[position] + "_";
+        int state = 0;
+        for (unsigned char character : pattern) {
+            size_t transition = state * ALPHABET_SIZE + character;
+            if (m_transitions[transition] == -1) {
+                m_transitions[transition] = static_cast<int>(m_matches.size());
+                m_matches.push_back(-1);
+                m_transitions.resize(m_transitions.size() + ALPHABET_SIZE, -1);
+            }
+            state = m_transitions[transition];
+        }
+        m_matches[state] = std::max(m_matches[state], static_cast<int>(position));
+    }
+    // breadth first pass turning failure links into a complete transition table
+    vector<int> failure(m_matches.size(), 0);
+    std::queue<int> pending;
+    for (int character = 0; character < ALPHABET_SIZE; character++) {
+        int& next = m_transitions[character];
+        if (next == -1) {
+            next = 0;
+        } else {
+            pending.push(next);
+        }
+    }
+    while (!pending.empty()) {
+        int state = pending.front();
+        pending.pop();
+        m_matches[state] = std::max(m_matches[state], m_matches[failure[state]]);
+        for (int character = 0; character < ALPHABET_SIZE; character++) {
+            int& next = m_transitions[state * ALPHABET_SIZE + character];
+            int fallback = m_transitions[failure[state] * ALPHABET_SIZE + character];
+            if (next == -1) {
+                next = fallback;
+            } else {
+                failure[next] = fallback;
+                pending.push(next);
+            }
+        }
+    }
+}
+
+int PrefixMatcher::match(const StrView& layerName) const {
+    int state = 0;
+    int found = -1;
+    for (unsigned char character : layerName) {
+        state = m_transitions[state * ALPHABET_SIZE + character];
+        found = std::max(found, m_matches[state]);
+    }
+    return found;
+}
+
+const string& PrefixMatcher::prefix(int position) const {
+    return m_prefixes[position];
+}
+
+bool isLayerPattern(const StrView& layerName) {
+    for (char character : layerName) {
+        if (character == '*' || character == '?' || character == '[') {
+            return true;
+        }
+    }
+    return false;
+}
+
+// one element of a glob pattern : "*", or a set of bytes matching a single character
+struct GlobToken {
+    bool isStar;
+    std::bitset<ALPHABET_SIZE> bytes;
+};
+
+static vector<GlobToken> _parseGlob(const string& pattern) {
+    vector<GlobToken> tokens;
+    for (size_t position = 0; position < pattern.size(); position++) {
+        GlobToken token = {false, std::bitset<ALPHABET_SIZE>()};
+        unsigned char character = pattern[position];
+        size_t closing = pattern.find(']', position + 2); // "[]abc]" contains "]"
+        if (character == '*') {
+            if (!tokens.empty() && tokens.back().isStar) {
+                continue; // "**" is "*"
+            }
+            token.isStar = true;
+        } else if (character == '?') {
+            token.bytes.set();
+        } else if (character == '[' && closing != string::npos) {
+            size_t first = position + 1;
+            bool negate = pattern[first] == '!' || pattern[first] == '^';
+            if (negate) {
+                first++;
+                closing = pattern.find(']', first + 1);
+                if (closing == string::npos) {
+                    throw std::invalid_argument("unterminated character class in layer pattern " + pattern);
+                }
+            }
+            for (size_t index = first; index < closing; index++) {
+                unsigned char low = pattern[index];
+                if (index + 2 < closing && pattern[index + 1] == '-') {
+                    unsigned char high = pattern[index + 2];
+                    for (int byte = low; byte <= high; byte++) { // a byte counter would never pass "\xff"
+                        token.bytes.set(byte);
+                    }
+                    index += 2;
+                } else {
+                    token.bytes.set(low);
+                }
+            }
+            if (negate) {
+                token.bytes.flip();
+            }
+            position = closing;
+        } else {
+            if (character == '\\' && position + 1 < pattern.size()) {
+                character = pattern[++position];
+            }
+            token.bytes.set(character);
+        }
+        tokens.push_back(token);
+    }
+    return tokens;
+}
+
+// DFA states are bigger than this only for pathological patterns
+static const size_t PATTERN_MAX_STATES = 1 << 16;
+
+PatternMatcher::PatternMatcher() : m_classCount(1), m_start(1), m_transitions(2, 0), m_accepts(2) {
+    std::fill(m_classes, m_classes + ALPHABET_SIZE, 0);
+}
+
+PatternMatcher::PatternMatcher(const StrVecType& patterns, const vector<IdType>& categoryIds) {
+    // NFA : one state per token of each pattern, plus its accepting end state
+    vector<GlobToken> tokens;
+    vector<size_t> ends; // NFA state of the end of each pattern
+    vector<size_t> starts;
+    for (const auto& pattern : patterns) {
+        starts.push_back(tokens.size());
+        vector<GlobToken> patternTokens = _parseGlob(pattern);
+        tokens.insert(tokens.end(), patternTokens.begin(), patternTokens.end());
+        ends.push_back(tokens.size());
+        GlobToken end = {false, std::bitset<ALPHABET_SIZE>()};
+        tokens.push_back(end); // never matches, ends the pattern
+    }
+    vector<vector<IdType> > acceptedByState(tokens.size());
+    for (size_t index = 0; index < patterns.size(); index++) {
+        acceptedByState[ends[index]].push_back(categoryIds[index]);
+    }
+
+    // bytes all tokens treat the same share a class
+    std::fill(m_classes, m_classes + ALPHABET_SIZE, 0);
+    m_classCount = 1;
+    for (const auto& token : tokens) {
+        if (token.isStar) {
+            continue;
+        }
+        std::map<std::pair<unsigned, bool>, unsigned> refined;
+        for (int byte = 0; byte < ALPHABET_SIZE; byte++) {
+            auto key = std::make_pair(unsigned(m_classes[byte]), bool(token.bytes.test(byte)));
+            auto it = refined.emplace(key, static_cast<unsigned>(refined.size())).first;
+            m_classes[byte] = static_cast<unsigned char>(it->second);
+        }
+        m_classCount = refined.size();
+    }
+    vector<unsigned char> representatives(m_classCount);
+    for (int byte = ALPHABET_SIZE - 1; byte >= 0; byte--) {
+        representatives[m_classes[byte]] = static_cast<unsigned char>(byte);
+    }
+
+    // subset construction, a DFA state is a sorted set of NFA states
+    auto closure = [&tokens](vector<size_t>& states) {
+        for (size_t index = 0; index < states.size(); index++) {
+            if (tokens[states[index]].isStar) { // "*" also matches nothing
+                states.push_back(states[index] + 1);
+            }
+        }
+        std::sort(states.begin(), states.end());
+        states.erase(std::unique(states.begin(), states.end()), states.end());
+    };
+    std::map<vector<size_t>, unsigned> stateIds;
+    vector<vector<size_t> > dfaStates;
+    auto addState = [&](const vector<size_t>& states) -> unsigned {
+        auto it = stateIds.find(states);
+        if (it != stateIds.end()) {
+            return it->second;
+        }
+        if (dfaStates.size() >= PATTERN_MAX_STATES) {
+            throw std::invalid_argument("layer patterns are too complex to be compiled");
+        }
+        unsigned stateId = static_cast<unsigned>(dfaStates.size());
+        stateIds.emplace(states, stateId);
+        dfaStates.push_back(states);
+        return stateId;
+    };
+    addState(vector<size_t>()); // the dead state
+    vector<size_t> startStates = starts;
+    closure(startStates);
+    m_start = addState(startStates); // without patterns the start state is the dead state
+
+    for (size_t stateId = 0; stateId < dfaStates.size(); stateId++) {
+        vector<IdType> accepted;
+        for (auto nfaState : dfaStates[stateId]) {
+            accepted.insert(accepted.end(), acceptedByState[nfaState].begin(), acceptedByState[nfaState].end());
+        }
+        std::sort(accepted.begin(), accepted.end());
+        accepted.erase(std::unique(accepted.begin(), accepted.end()), accepted.end());
+        m_accepts.push_back(accepted);
+
+        for (size_t byteClass = 0; byteClass < m_classCount; byteClass++) {
+            unsigned char byte = representatives[byteClass];
+            vector<size_t> next;
+            for (auto nfaState : dfaStates[stateId]) {
+                if (tokens[nfaState].isStar) {
+                    next.push_back(nfaState);
+                } else if (tokens[nfaState].bytes.test(byte)) {
+                    next.push_back(nfaState + 1);
+                }
+            }
+            closure(next);
+            m_transitions.push_back(addState(next)); // dfaStates may grow, stateId is an index
+        }
+    }
+}
+
+const vector<IdType>& PatternMatcher::match(const StrView& layerName) const {
+    unsigned state = m_start;
+    for (unsigned char character : layerName) {
+        state = m_transitions[state * m_classCount + m_classes[character]];
+        if (state == 0) {
+            return NO_CATEGORIES;
+        }
+    }
+    return m_accepts[state];
+}
+
+bool PatternMatcher::empty() const {
+    return m_accepts.size() <= 2 && (m_accepts.size() < 2 || m_accepts[1].empty());
+}
+
+size_t PatternMatcher::stateCount() const {
+    return m_accepts.size();
+}
+
+LayerIndex::LayerIndex() {
+}
+
+LayerIndex::LayerIndex(const ConfigMapType& configMap) {
+    StrVecType patterns;
+    vector<IdType> patternCategories;
+    for (const auto& kvp : configMap) {
+        if (kvp.second.isRemoval) {
+            continue;
+        }
+        IdType categoryId = m_categories.intern(kvp.first);
+        for (const auto& layer : kvp.second.values) {
+            if (isLayerPattern(layer)) {
+                patterns.push_back(layer);
+                patternCategories.push_back(categoryId);
+            } else {
+                m_layers.intern(layer);
+            }
+        }
+    }
+    m_patterns = PatternMatcher(patterns, patternCategories);
+    size_t categoryCount = m_categories.size();
+    m_members.reserve(categoryCount);
+    m_privateCategories.reserve(categoryCount);
+    m_layerCategories.resize(m_layers.size());
+    m_directSubcategories.assign(categoryCount, vector<IdType>());
+    for (const auto& kvp : configMap) {
+        if (kvp.second.isRemoval) {
+            continue;
+        }
+        IdType categoryId = static_cast<IdType>(m_members.size());
+        CategoryBitset members(m_layers.size());
+        for (const auto& layer : kvp.second.values) {
+            IdType layerId = m_layers.find(layer);
+            if (layerId == INVALID_ID) { // a pattern
+                continue;
+            }
+            if (!members.test(layerId)) { // categories are visited in id order, so this stays sorted
+                m_layerCategories[layerId].push_back(categoryId);
+            }
+            members.set(layerId);
+        }
+        m_members.push_back(members);
+        m_privateCategories.push_back(kvp.first.find("_") == 0);
+        vector<IdType>& subcategories = m_directSubcategories[categoryId];
+        for (const auto& merged : kvp.second.merges) {
+            IdType subcategoryId = m_categories.find(merged);
+            if (subcategoryId != INVALID_ID && subcategoryId != categoryId) {
+                subcategories.push_back(subcategoryId);
+            }
+        }
+        std::sort(subcategories.begin(), subcategories.end());
+        subcategories.erase(std::unique(subcategories.begin(), subcategories.end()), subcategories.end());
+    }
+
+    // transitive closure of the merges. Files merging each other's categories make cycles,
+    // a category is never its own subcategory
+    m_subcategories.assign(categoryCount, CategoryBitset(categoryCount));
+    vector<IdType> pending;
+    for (IdType categoryId = 0; categoryId < categoryCount; categoryId++) {
+        CategoryBitset& subcategories = m_subcategories[categoryId];
+        pending = m_directSubcategories[categoryId];
+        while (!pending.empty()) {
+            IdType subcategoryId = pending.back();
+            pending.pop_back();
+            if (subcategoryId == categoryId || subcategories.test(subcategoryId)) {
+                continue;
+            }
+            subcategories.set(subcategoryId);
+            const vector<IdType>& merged = m_directSubcategories[subcategoryId];
+            pending.insert(pending.end(), merged.begin(), merged.end());
+        }
+    }
+}
+
+IdType LayerIndex::layerId(const StrView& layerName) const {
+    return m_layers.find(layerName);
+}
+
+IdType LayerIndex::categoryId(const StrView& categoryName) const {
+    return m_categories.find(categoryName);
+}
+
+const string& LayerIndex::layerName(IdType layerId) const {
+    return m_layers.name(layerId);
+}
+
+const string& LayerIndex::categoryName(IdType categoryId) const {
+    return m_categories.name(categoryId);
+}
+
+size_t LayerIndex::layerCount() const {
+    return m_layers.size();
+}
+
+size_t LayerIndex::categoryCount() const {
+    return m_categories.size();
+}
+
+bool LayerIndex::isMember(IdType categoryId, IdType layerId) const {
+    if (categoryId == INVALID_ID || layerId == INVALID_ID) {
+        return false;
+    }
+    return m_members[categoryId].test(layerId);
+}
+
+bool LayerIndex::isPrivate(IdType categoryId) const {
+    return m_privateCategories[categoryId];
+}
+
+const vector<IdType>& LayerIndex::categoriesOf(IdType layerId) const {
+    return layerId != INVALID_ID ? m_layerCategories[layerId] : NO_CATEGORIES;
+}
+
+const vector<IdType>& LayerIndex::patternCategoriesOf(const StrView& layerName) const {
+    return hasPatterns() ? m_patterns.match(layerName) : NO_CATEGORIES;
+}
+
+bool LayerIndex::hasPatterns() const {
+    return !m_patterns.empty();
+}
+
+bool LayerIndex::isSubcategory(IdType categoryId, IdType subcategoryId) const {
+    if (categoryId == INVALID_ID || subcategoryId == INVALID_ID) {
+        return false;
+    }
+    return m_subcategories[categoryId].test(subcategoryId);
+}
+
+const CategoryBitset& LayerIndex::subcategoriesOf(IdType categoryId) const {
+    return m_subcategories[categoryId];
+}
+
+const vector<IdType>& LayerIndex::directSubcategoriesOf(IdType categoryId) const {
+    return categoryId != INVALID_ID ? m_directSubcategories[categoryId] : NO_CATEGORIES;
+}
+
+TopologyTable::TopologyTable() {
+}
+
+TopologyTable::TopologyTable(const LayerIndex& index, const StrVecType& topologyCategories,
+                             const vector<StrVecType>& topologyChannels, const StrVecType& defaultChannels) :
+m_positions(index.categoryCount(), -1),
+m_channels(topologyChannels),
+m_defaultChannels(defaultChannels) {
+    for (size_t position = 0; position < topologyCategories.size(); position++) {
+        IdType categoryId = index.categoryId(topologyCategories[position]);
+        if (categoryId != INVALID_ID) {
+            m_positions[categoryId] = static_cast<int>(position); // a repeated category keeps its last position
+        }
+    }
+}
+
+int TopologyTable::position(IdType categoryId) const {
+    return categoryId < m_positions.size() ? m_positions[categoryId] : -1;
+}
+
+const StrVecType& TopologyTable::channels(int position) const {
+    return position < 0 ? m_defaultChannels : m_channels[position];
+}
+
+ChannelNameBuffer::ChannelNameBuffer() : m_offsets(1, 0) {
+}
+
+void ChannelNameBuffer::clear() {
+    m_characters.clear();
+    m_offsets.assign(1, 0);
+}
+
+size_t ChannelNameBuffer::append(const StrView& layerName, const StrVecType& channelNames) {
+    size_t required = 0;
+    for (auto iterChannel = channelNames.begin(); iterChannel != channelNames.end(); iterChannel++) {
+        required += layerName.size() + iterChannel->size() + 2;
+    }
+    m_characters.reserve(m_characters.size() + required);
+    for (auto iterChannel = channelNames.begin(); iterChannel != channelNames.end(); iterChannel++) {
+        m_characters.append(layerName.data(), layerName.size());
+        m_characters.push_back('.');
+        m_characters.append(*iterChannel);
+        m_characters.push_back('\0');
+        m_offsets.push_back(m_characters.size());
+    }
+    return channelNames.size();
+}
+
+size_t ChannelNameBuffer::size() const {
+    return m_offsets.size() - 1;
+}
+
+const char* ChannelNameBuffer::name(size_t index) const {
+    return m_characters.data() + m_offsets[index];
+}
+
+size_t ChannelNameBuffer::length(size_t index) const {
+    return m_offsets[index + 1] - m_offsets[index] - 1;
+}
+
+StrView ChannelNameBuffer::view(size_t index) const {
+    return StrView(name(index), length(index));
+}
+
+StrVecType ChannelNameBuffer::names() const {
+    StrVecType channelNames;
+    channelNames.reserve(size());
+    for (size_t index = 0; index < size(); index++) {
+        channelNames.emplace_back(name(index), length(index));
+    }
+    return channelNames;
+}
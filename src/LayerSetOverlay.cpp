@@ -0,0 +1,127 @@
+/*
+ * implementation code for the configuration overlay stacks
+ */
+
+#include "LayerSetOverlay.h"
+
+// categories set by a stack level, on top of the levels below it
+struct ConfigStack::Level {
+    std::shared_ptr<const Level> below;
+    // a null value is a category removed by this level
+    map<string, std::shared_ptr<const ConfigValues> > categories;
+    size_t depth = 0;
+};
+
+ConfigStack::ConfigStack() : m_top(std::make_shared<Level>()) {
+}
+
+ConfigStack::ConfigStack(std::shared_ptr<const Level> top) : m_top(std::move(top)) {
+}
+
+ConfigStack::ConfigStack(ConfigMapType base) {
+    std::shared_ptr<Level> level = std::make_shared<Level>();
+    for (auto& kvp : base) {
+        // nothing to remove from in a base
+        if (!kvp.second.isRemoval) {
+            level->categories.emplace_hint(level->categories.end(), kvp.first,
+                                           std::make_shared<const ConfigValues>(std::move(kvp.second)));
+        }
+    }
+    m_top = level;
+}
+
+ConfigStack::ConfigStack(const StrMapType& base, bool mergeValues) {
+    std::shared_ptr<Level> level = std::make_shared<Level>();
+    for (const auto& kvp : base) {
+        ConfigValues configValues = {kvp.second, StrVecType(), mergeValues, false};
+        level->categories.emplace_hint(level->categories.end(), kvp.first,
+                                       std::make_shared<const ConfigValues>(std::move(configValues)));
+    }
+    m_top = level;
+}
+
+ConfigStack ConfigStack::load(const string& path) {
+    return ConfigStack(_loadConfigMap(path));
+}
+
+ConfigStack ConfigStack::push(const ConfigMapType& overlay) const {
+    std::shared_ptr<Level> level = std::make_shared<Level>();
+    level->below = m_top;
+    level->depth = m_top->depth + 1;
+    for (const auto& kvp : overlay) {
+        const ConfigValues* current = find(kvp.first);
+        if (!current) {
+            if (!kvp.second.isRemoval) {
+                level->categories.emplace_hint(level->categories.end(), kvp.first,
+                                               std::make_shared<const ConfigValues>(kvp.second));
+            }
+            continue;
+        }
+        // copied on write, the levels below keep theirs
+        ConfigValues configValues = *current;
+        _mergeConfigValues(configValues, kvp.second);
+        if (kvp.second.isRemoval && configValues.values.empty()) {
+            level->categories.emplace_hint(level->categories.end(), kvp.first, nullptr);
+        } else {
+            level->categories.emplace_hint(level->categories.end(), kvp.first,
+                                           std::make_shared<const ConfigValues>(std::move(configValues)));
+        }
+    }
+    return ConfigStack(std::shared_ptr<const Level>(level));
+}
+
+ConfigStack ConfigStack::push(const string& overlayPath) const {
+    return push(_loadConfigMap(overlayPath));
+}
+
+const ConfigValues* ConfigStack::find(const string& category) const {
+    for (const Level* level = m_top.get(); level; level = level->below.get()) {
+        auto it = level->categories.find(category);
+        if (it != level->categories.end()) {
+            return it->second.get();
+        }
+    }
+    return nullptr;
+}
+
+bool ConfigStack::contains(const string& category) const {
+    return find(category) != nullptr;
+}
+
+ConfigMapType ConfigStack::toConfigMap() const {
+    // the highest level setting a category wins
+    map<string, const ConfigValues*> categories;
+    for (const Level* level = m_top.get(); level; level = level->below.get()) {
+        for (const auto& kvp : level->categories) {
+            categories.emplace(kvp.first, kvp.second.get());
+        }
+    }
+    ConfigMapType configMap;
+    for (const auto& kvp : categories) {
+        if (kvp.second) {
+            configMap.emplace_hint(configMap.end(), kvp.first, *kvp.second);
+        }
+    }
+    return configMap;
+}
+
+StrMapType ConfigStack::toMap() const {
+    // the highest level setting a category wins
+    map<string, const ConfigValues*> categories;
+    for (const Level* level = m_top.get(); level; level = level->below.get()) {
+        for (const auto& kvp : level->categories) {
+            categories.emplace(kvp.first, kvp.second.get());
+        }
+    }
+    StrMapType categoryMap;
+    for (const auto& kvp : categories) {
+        if (kvp.second) {
+            categoryMap.emplace_hint(categoryMap.end(), kvp.first, kvp.second->values);
+        }
+    }
+    return categoryMap;
+}
+
+size_t ConfigStack::depth() const {
+    return m_top->depth;
+}
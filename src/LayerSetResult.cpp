@@ -0,0 +1,208 @@
+/*
+ * implementation code for the reusable categorization results
+ */
+
+#include <algorithm>
+
+#include "LayerSetCore.h"
+#include "LayerSetResult.h"
+#include "LayerSetStats.h"
+
+static const string ALL_CATEGORY = "all";
+static const unsigned NO_LAYER = static_cast<unsigned>(-1);
+
+MonotonicArena::MonotonicArena(size_t blockSize) : m_blockSize(blockSize), m_current(0), m_used(0) {
+}
+
+StrView MonotonicArena::copy(const StrView& characters) {
+    while (m_current < m_blocks.size() && m_used + characters.size() > m_blockSizes[m_current]) {
+        m_current++; // the next kept block, if any, may have room
+        m_used = 0;
+    }
+    if (m_current == m_blocks.size()) {
+        size_t blockSize = std::max(characters.size(), m_blockSize << m_blocks.size());
+        m_blocks.emplace_back(new char[blockSize]);
+        stats::add(stats::arenaBlocks);
+        m_blockSizes.push_back(blockSize);
+        m_used = 0;
+    }
+    char* destination = m_blocks[m_current].get() + m_used;
+    std::copy(characters.begin(), characters.end(), destination);
+    m_used += characters.size();
+    return StrView(destination, characters.size());
+}
+
+void MonotonicArena::reset() {
+    m_current = 0;
+    m_used = 0;
+}
+
+size_t MonotonicArena::capacity() const {
+    size_t total = 0;
+    for (auto blockSize : m_blockSizes) {
+        total += blockSize;
+    }
+    return total;
+}
+
+CategorizeResult::CategorizeResult() : m_allCategoryId(INVALID_ID), m_lastAllLayer(NO_LAYER) {
+}
+
+void CategorizeResult::clear() {
+    m_categories.clear();
+    m_members.clear();
+    m_arena.reset();
+    m_layers.clear();
+    m_memberships.clear();
+    m_lastAllLayer = NO_LAYER;
+}
+
+size_t CategorizeResult::size() const {
+    return m_categories.size();
+}
+
+bool CategorizeResult::empty() const {
+    return m_categories.empty();
+}
+
+StrView CategorizeResult::category(size_t index) const {
+    return m_categories[index].name;
+}
+
+CategorizeResult::MemberRange CategorizeResult::members(size_t index) const {
+    const StrView* first = m_members.data() + m_categories[index].first;
+    return MemberRange(first, first + m_categories[index].count);
+}
+
+CategorizeResult::MemberRange CategorizeResult::members(const StrView& categoryName) const {
+    int index = find(categoryName);
+    return index < 0 ? MemberRange(nullptr, nullptr) : members(index);
+}
+
+int CategorizeResult::find(const StrView& categoryName) const {
+    auto it = std::lower_bound(m_categories.begin(), m_categories.end(), categoryName,
+        [](const Category& category, const StrView& name) {return category.name < name;});
+    return (it != m_categories.end() && it->name == categoryName) ? static_cast<int>(it - m_categories.begin()) : -1;
+}
+
+bool CategorizeResult::contains(const StrView& categoryName) const {
+    return !(categoryName.size() && categoryName[0] == '_') && find(categoryName) != -1;
+}
+
+bool CategorizeResult::isMember(const StrView& categoryName, const StrView& layerName) const {
+    MemberRange layers = members(categoryName);
+    return std::find(layers.begin(), layers.end(), layerName) != layers.end();
+}
+
+LayerMap CategorizeResult::toLayerMap() const {
+    stats::add(stats::layerMapsBuilt);
+    LayerMap layerMap;
+    StrVecType layers;
+    for (size_t index = 0; index < size(); index++) {
+        layers.clear();
+        for (const auto& layer : members(index)) {
+            layers.emplace_back(layer.str());
+        }
+        layerMap.set(category(index).str(), layers);
+    }
+    return layerMap;
+}
+
+void CategorizeResult::_start(const StrVecType& layerNames, const LayerIndex& index) {
+    clear();
+    // layer names without channel names, in input order
+    for (const auto& layerName : layerNames) {
+        m_layers.push_back(utilities::getLayerViewFromChannel(layerName));
+    }
+    _uniqueLayers(index);
+}
+
+void CategorizeResult::_start(const StrViewSpan& layerNames, const LayerIndex& index) {
+    clear();
+    for (const auto& layerName : layerNames) {
+        m_layers.push_back(utilities::getLayerViewFromChannel(layerName));
+    }
+    _uniqueLayers(index);
+}
+
+void CategorizeResult::_uniqueLayers(const LayerIndex& index) {
+    IdType allCategoryId = index.categoryId(ALL_CATEGORY);
+    m_allCategoryId = allCategoryId != INVALID_ID ? allCategoryId : static_cast<IdType>(index.categoryCount());
+    // sort positions by name then position, the first of each run of equal names is kept
+    m_order.resize(m_layers.size());
+    for (unsigned position = 0; position < m_order.size(); position++) {
+        m_order[position] = position;
+    }
+    std::sort(m_order.begin(), m_order.end(), [this](unsigned a, unsigned b) {
+        int order = m_layers[a].compare(m_layers[b]);
+        return order != 0 ? order < 0 : a < b;
+    });
+    for (size_t order = 1; order < m_order.size(); order++) {
+        if (m_layers[m_order[order]] == m_layers[m_order[order - 1]]) {
+            m_order[order] = m_order[order - 1]; // replace duplicates by their first position
+        }
+    }
+    // first positions in input order
+    std::sort(m_order.begin(), m_order.end());
+    m_order.erase(std::unique(m_order.begin(), m_order.end()), m_order.end());
+    size_t uniqueCount = 0;
+    for (auto position : m_order) {
+        StrView layer = m_layers[position];
+        IdType layerId = index.layerId(layer);
+        m_layers[uniqueCount++] = layerId != INVALID_ID ? StrView(index.layerName(layerId)) : m_arena.copy(layer);
+    }
+    m_layers.resize(uniqueCount);
+}
+
+void CategorizeResult::_addToAll(unsigned layer) {
+    if (m_lastAllLayer != layer) { // layers are categorized one after the other
+        m_memberships.emplace_back(m_allCategoryId, layer);
+        m_lastAllLayer = layer;
+    }
+}
+
+void CategorizeResult::_add(IdType categoryId, unsigned layer) {
+    if (categoryId == m_allCategoryId) {
+        _addToAll(layer);
+    } else {
+        m_memberships.emplace_back(categoryId, layer);
+    }
+}
+
+void CategorizeResult::_build(const LayerIndex& index) {
+    // counting sort of the memberships by category id, stable so layers stay in input order
+    size_t categoryCount = index.categoryCount() + 1; // "all" may not be in the configuration
+    m_offsets.assign(categoryCount + 1, 0);
+    for (const auto& membership : m_memberships) {
+        m_offsets[membership.first + 1]++;
+    }
+    for (size_t categoryId = 0; categoryId < categoryCount; categoryId++) {
+        m_offsets[categoryId + 1] += m_offsets[categoryId];
+    }
+    m_cursors.assign(m_offsets.begin(), m_offsets.end() - 1);
+    m_members.resize(m_memberships.size());
+    for (const auto& membership : m_memberships) {
+        m_members[m_cursors[membership.first]++] = m_layers[membership.second];
+    }
+    // category ids follow name order, "all" is inserted in place when it is not in the configuration
+    m_categories.clear();
+    auto addCategory = [this](IdType categoryId, const StrView& name) {
+        size_t count = m_offsets[categoryId + 1] - m_offsets[categoryId];
+        if (count) {
+            Category category = {name, m_offsets[categoryId], count};
+            m_categories.push_back(category);
+        }
+    };
+    bool allAdded = m_allCategoryId < index.categoryCount();
+    for (IdType categoryId = 0; categoryId < index.categoryCount(); categoryId++) {
+        const string& name = index.categoryName(categoryId);
+        if (!allAdded && StrView(ALL_CATEGORY) < StrView(name)) {
+            addCategory(m_allCategoryId, ALL_CATEGORY);
+            allAdded = true;
+        }
+        addCategory(categoryId, name);
+    }
+    if (!allAdded) {
+        addCategory(m_allCategoryId, ALL_CATEGORY);
+    }
+}
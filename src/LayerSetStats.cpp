@@ -0,0 +1,130 @@
+/*
+ * implementation code for the opt-in statistics
+ */
+
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <unordered_set>
+
+#include "LayerSetStats.h"
+
+namespace stats {
+
+static const char* COUNTER_NAMES[counterCount] = {
+    "config_loads", "categorize_calls", "layers_categorized", "cache_hits", "cache_misses",
+    "topology_calls", "layer_maps_built", "arena_blocks"};
+static const char* TIMER_NAMES[timerCount] = {"config_load", "categorize", "topology"};
+
+// values of one thread, only written by it. Atomics so they can be read while being written
+struct ThreadStats {
+    std::atomic<uint64_t> counters[counterCount];
+    std::atomic<uint64_t> nanoseconds[timerCount];
+    ThreadStats();
+    ~ThreadStats();
+};
+
+// live threads, and the totals of the threads that exited
+struct Registry {
+    std::mutex mutex;
+    std::unordered_set<const ThreadStats*> threads;
+    Totals retired;
+    Registry() : retired() {}
+};
+
+static Registry& _registry() {
+    // never destroyed, threads can exit after static destructors ran
+    static Registry* registry = new Registry();
+    return *registry;
+}
+
+ThreadStats::ThreadStats() {
+    for (auto& counter : counters) {
+        counter.store(0, std::memory_order_relaxed);
+    }
+    for (auto& timer : nanoseconds) {
+        timer.store(0, std::memory_order_relaxed);
+    }
+    Registry& registry = _registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.threads.insert(this);
+}
+
+ThreadStats::~ThreadStats() {
+    Registry& registry = _registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (int index = 0; index < counterCount; index++) {
+        registry.retired.counters[index] += counters[index].load(std::memory_order_relaxed);
+    }
+    for (int index = 0; index < timerCount; index++) {
+        registry.retired.nanoseconds[index] += nanoseconds[index].load(std::memory_order_relaxed);
+    }
+    registry.threads.erase(this);
+}
+
+static ThreadStats& _threadStats() {
+    static thread_local ThreadStats threadStats;
+    return threadStats;
+}
+
+// only the owning thread writes, a relaxed load and store is enough and avoids a locked instruction
+static void _increment(std::atomic<uint64_t>& value, uint64_t amount) {
+    value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+void _add(Counter counter, uint64_t amount) {
+    _increment(_threadStats().counters[counter], amount);
+}
+
+void _addTime(Timer timer, uint64_t nanoseconds) {
+    _increment(_threadStats().nanoseconds[timer], nanoseconds);
+}
+
+Totals totals() {
+    Registry& registry = _registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    Totals sums = registry.retired;
+    for (const ThreadStats* threadStats : registry.threads) {
+        for (int index = 0; index < counterCount; index++) {
+            sums.counters[index] += threadStats->counters[index].load(std::memory_order_relaxed);
+        }
+        for (int index = 0; index < timerCount; index++) {
+            sums.nanoseconds[index] += threadStats->nanoseconds[index].load(std::memory_order_relaxed);
+        }
+    }
+    return sums;
+}
+
+string toJson() {
+    Totals sums = totals();
+    std::ostringstream json;
+    json << "{\n  \"counters\": {";
+    for (int index = 0; index < counterCount; index++) {
+        json << (index ? "," : "") << "\n    \"" << COUNTER_NAMES[index] << "\": " << sums.counters[index];
+    }
+    json << "\n  },\n  \"timers_ms\": {";
+    for (int index = 0; index < timerCount; index++) {
+        json << (index ? "," : "") << "\n    \"" << TIMER_NAMES[index] << "\": " << sums.nanoseconds[index] * 1e-6;
+    }
+    json << "\n  }\n}\n";
+    return json.str();
+}
+
+bool dump(const string& filePath) {
+    std::ofstream outputFile(filePath);
+    return static_cast<bool>(outputFile << toJson());
+}
+
+static void _dumpAtExit() {
+    const char* filePath = getenv(STATS_ENV_VAR);
+    if (filePath && !dump(filePath)) {
+        std::cerr << "LayerAlchemy : can't write statistics to " << filePath << std::endl;
+    }
+}
+
+// registers the dump when the library is loaded with statistics enabled
+static const bool dumpRegistered = enabled() && (_registry(), std::atexit(_dumpAtExit) == 0);
+
+} // stats
@@ -0,0 +1,219 @@
+/*
+ * implementation code for the configuration file watcher
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+#include <fnmatch.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+#include "LayerSetConfig.h"
+#include "LayerSetWatcher.h"
+
+// time to wait for more file events before reloading, editors often write files in several steps
+static const int DEBOUNCE_MILLISECONDS = 250;
+
+static string _directoryName(const string& path) {
+    size_t separator = path.rfind('/');
+    if (separator == string::npos) {
+        return ".";
+    }
+    return separator == 0 ? "/" : path.substr(0, separator);
+}
+
+static string _baseName(const string& path) {
+    size_t separator = path.rfind('/');
+    return separator == string::npos ? path : path.substr(separator + 1);
+}
+
+LayerCollectionWatcher::LayerCollectionWatcher(const string& layerConfigPath, const string& channelConfigPath,
+                                               bool overEmbedded) :
+m_layerConfigPath(layerConfigPath),
+m_channelConfigPath(channelConfigPath),
+m_overEmbedded(overEmbedded),
+m_current(std::make_shared<const LayerCollection>(layerConfigPath, channelConfigPath, 0, overEmbedded)),
+m_generation(0),
+m_running(false) {
+    m_stopPipe[0] = m_stopPipe[1] = -1;
+}
+
+LayerCollectionWatcher::~LayerCollectionWatcher() {
+    stop();
+}
+
+bool LayerCollectionWatcher::enabled() {
+    const char* watchValue = getenv(WATCH_ENV_VAR);
+    return watchValue != nullptr && string(watchValue) == "1";
+}
+
+LayerCollectionPtr LayerCollectionWatcher::snapshot() const {
+    return std::atomic_load(&m_current);
+}
+
+unsigned long LayerCollectionWatcher::generation() const {
+    return m_generation.load(std::memory_order_acquire);
+}
+
+bool LayerCollectionWatcher::running() const {
+    return m_running;
+}
+
+bool LayerCollectionWatcher::reload() {
+    std::lock_guard<std::mutex> lock(m_publishMutex);
+    unsigned long nextGeneration = m_generation + 1;
+    LayerCollectionPtr next;
+    try {
+        next = std::make_shared<const LayerCollection>(m_layerConfigPath, m_channelConfigPath, nextGeneration, m_overEmbedded);
+    } catch (const std::exception& e) {
+        std::cerr << "LayerAlchemy ERROR : configuration reload failed, keeping generation "
+                  << m_generation << " : " << e.what() << std::endl;
+        return false;
+    }
+    // the previous snapshot is freed here, or by its last reader
+    std::atomic_store(&m_current, next);
+    m_generation.store(nextGeneration, std::memory_order_release);
+    return true;
+}
+
+void LayerCollectionWatcher::start() {
+    if (m_thread.joinable()) {
+        return;
+    }
+    if (pipe(m_stopPipe) != 0) {
+        std::cerr << "LayerAlchemy ERROR : can't start the configuration watcher" << std::endl;
+        return;
+    }
+    m_running = true;
+    m_thread = std::thread(&LayerCollectionWatcher::_watch, this);
+}
+
+void LayerCollectionWatcher::stop() {
+    if (!m_thread.joinable()) {
+        return;
+    }
+    m_running = false;
+    char wake = 0;
+    if (write(m_stopPipe[1], &wake, 1) < 0) {
+        std::cerr << "LayerAlchemy ERROR : can't wake up the configuration watcher" << std::endl;
+    }
+    m_thread.join();
+    close(m_stopPipe[0]);
+    close(m_stopPipe[1]);
+    m_stopPipe[0] = m_stopPipe[1] = -1;
+}
+
+#ifdef __linux__
+
+static bool _isDirectory(const string& path) {
+    struct stat pathStat;
+    return stat(path.c_str(), &pathStat) == 0 && S_ISDIR(pathStat.st_mode);
+}
+
+// a configuration file is watched through its directory, a configuration directory is watched directly
+static string _watchedDirectory(const string& configPath) {
+    return _isDirectory(configPath) ? configPath : _directoryName(configPath);
+}
+
+// true if a file name in a watched directory is part of the configuration
+static bool _isConfigFile(const string& configPath, const string& fileName) {
+    if (_isDirectory(configPath)) {
+        return fnmatch(CONFIG_FILE_PATTERN.c_str(), fileName.c_str(), FNM_PERIOD) == 0;
+    }
+    return fileName == _baseName(configPath);
+}
+
+void LayerCollectionWatcher::_watch() {
+    int inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd < 0) {
+        std::cerr << "LayerAlchemy ERROR : inotify is not available, configuration changes are ignored" << std::endl;
+        m_running = false;
+        return;
+    }
+    // watch the directories, editors and deployments often replace files instead of writing them
+    const uint32_t eventMask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE;
+    inotify_add_watch(inotifyFd, _watchedDirectory(m_layerConfigPath).c_str(), eventMask);
+    inotify_add_watch(inotifyFd, _watchedDirectory(m_channelConfigPath).c_str(), eventMask);
+
+    struct pollfd fds[2] = {{inotifyFd, POLLIN, 0}, {m_stopPipe[0], POLLIN, 0}};
+    alignas(struct inotify_event) char buffer[4096];
+    bool pending = false;
+
+    while (m_running) {
+        int ready = poll(fds, 2, pending ? DEBOUNCE_MILLISECONDS : -1);
+        if (!m_running || (fds[1].revents & POLLIN)) {
+            break;
+        }
+        if (ready == 0 && pending) { // quiet for long enough, the files are complete
+            pending = false;
+            reload();
+            continue;
+        }
+        if (ready < 0 || !(fds[0].revents & POLLIN)) {
+            continue;
+        }
+        ssize_t length;
+        while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+            for (char* ptr = buffer; ptr < buffer + length;) {
+                const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(ptr);
+                if (event->len > 0) {
+                    string fileName(event->name);
+                    pending |= _isConfigFile(m_layerConfigPath, fileName) || _isConfigFile(m_channelConfigPath, fileName);
+                }
+                ptr += sizeof(struct inotify_event) + event->len;
+            }
+        }
+    }
+    close(inotifyFd);
+}
+
+#else
+
+// interval between modification time checks when inotify is not available
+static const int POLL_MILLISECONDS = 1000;
+
+static long long _modificationTime(const string& path) {
+    struct stat fileStat;
+    if (stat(path.c_str(), &fileStat) != 0) {
+        return -1;
+    }
+    long long modificationTime = static_cast<long long>(fileStat.st_mtime);
+    if (S_ISDIR(fileStat.st_mode)) { // the latest change of the directory or any of its configuration files
+        try {
+            for (const auto& filePath : configFilesInDirectory(path)) {
+                modificationTime = std::max(modificationTime, _modificationTime(filePath));
+            }
+        } catch (const std::exception&) {
+            return -1;
+        }
+    }
+    return modificationTime;
+}
+
+void LayerCollectionWatcher::_watch() {
+    long long layerConfigTime = _modificationTime(m_layerConfigPath);
+    long long channelConfigTime = _modificationTime(m_channelConfigPath);
+    struct pollfd fds[1] = {{m_stopPipe[0], POLLIN, 0}};
+
+    while (m_running) {
+        poll(fds, 1, POLL_MILLISECONDS);
+        if (!m_running || (fds[0].revents & POLLIN)) {
+            break;
+        }
+        long long currentLayerConfigTime = _modificationTime(m_layerConfigPath);
+        long long currentChannelConfigTime = _modificationTime(m_channelConfigPath);
+        if ((currentLayerConfigTime != layerConfigTime) || (currentChannelConfigTime != channelConfigTime)) {
+            layerConfigTime = currentLayerConfigTime;
+            channelConfigTime = currentChannelConfigTime;
+            reload();
+        }
+    }
+}
+
+#endif
@@ -2,11 +2,26 @@
  * Simple executable to test the layer categorization
  * This will just print out various methods of categorizing.
  */
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <new>
+#include <sstream>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "argparse.h"
 
+#include "LayerSetConfig.h"
+#include "LayerSetConfigCache.h"
 #include "LayerSetCore.h"
+#include "LayerSetEmbedded.h"
 #include "version.h"
 
 static const std::string emojiSick = "\xF0\x9F\x98\xB7 ";
@@ -19,6 +34,25 @@ static const std::string HEADER =
     "\n\nLayerAlchemy " + LAYER_ALCHEMY_VERSION_STRING + "\n" +
      LAYER_ALCHEMY_PROJECT_URL + "\n";
 
+// heap allocations made by each thread, the self tests check that warm categorization doesn't allocate
+static thread_local long long threadAllocations = 0;
+
+void* operator new(size_t size)
+{
+    void* memory = std::malloc(size ? size : 1);
+    if (!memory)
+    {
+        throw std::bad_alloc();
+    }
+    threadAllocations++;
+    return memory;
+}
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
 void _printLayerMap(const LayerMap &layerMap, std::string message)
 {
     std::cout << message + "\n" + layerMap.toString();
@@ -33,21 +67,496 @@ void _printLayerMapTopology(LayerCollection *layerCollection, const StrVecType l
         layerCollection->topology(layerNames, topologyStyle::lexical), "Topology style : LEXICAL");
 }
 
+// one list of layer names per line, separated by spaces, empty lines and lines starting with # are skipped
+vector<StrVecType> _readLayerLists(const string& filePath)
+{
+    std::ifstream inputFile(filePath);
+    if (!inputFile)
+    {
+        throw std::invalid_argument("can't read layer lists from " + filePath);
+    }
+    vector<StrVecType> layerLists;
+    string line;
+    while (std::getline(inputFile, line))
+    {
+        std::istringstream lineStream(line);
+        StrVecType layerNames;
+        string layerName;
+        while (lineStream >> layerName)
+        {
+            layerNames.push_back(layerName);
+        }
+        if (!layerNames.empty() && layerNames[0][0] != '#')
+        {
+            layerLists.push_back(layerNames);
+        }
+    }
+    return layerLists;
+}
+
+int _runBatch(const LayerCollection& layerCollection, const string& filePath, const CategorizeFilter* categorizeFilter, categorizeType catType)
+{
+    vector<StrVecType> layerLists = _readLayerLists(filePath);
+    auto start = std::chrono::steady_clock::now();
+    vector<LayerMap> layerMaps = categorizeFilter ?
+        layerCollection.categorizeLayers(layerLists, catType, *categorizeFilter) :
+        layerCollection.categorizeLayers(layerLists, catType);
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+    for (size_t index = 0; index < layerLists.size(); index++)
+    {
+        string layerNames;
+        for (const auto& layerName : layerLists[index])
+        {
+            layerNames += (layerNames.empty() ? "" : " ") + layerName;
+        }
+        std::cout << "-----------------------------------------------" << std::endl
+                  << "Layer names : '" << layerNames << "'";
+        _printLayerMap(layerMaps[index], " ");
+    }
+    // timings on stderr, to keep the output comparable between runs
+    std::cerr << "LayerAlchemy : categorized " << layerLists.size() << " layer lists in " << elapsed.count() << " ms" << std::endl;
+    return 0;
+}
+
+// prints the outcome of one self test check, returns 1 if it failed
+int _check(bool passed, const string& checkName)
+{
+    std::cout << (passed ? "PASSED : " : redText + "FAILED : ") << checkName << (passed ? "" : endColor) << std::endl;
+    return passed ? 0 : 1;
+}
+
+// batch contains() on categories given in any order, and membership after edits through the mutators
+int _testLayerMapContains()
+{
+    int failures = 0;
+    LayerMap layerMap(StrMapType {
+        {"zeta", {"b", "a"}}, {"alpha", {"c"}}, {"mid", {"q", "p", "q"}}, {"_hidden", {"x"}}});
+    failures += _check(layerMap.contains(StrVecType {"zeta", "alpha", "mid"}), "contains all categories, unsorted");
+    failures += _check(layerMap.contains(StrVecType {"mid", "zeta"}), "contains a subset, reversed");
+    failures += _check(layerMap.contains(StrVecType {"mid", "mid", "alpha"}), "contains duplicated categories");
+    failures += _check(layerMap.contains(StrVecType {}), "contains no categories");
+    failures += _check(!layerMap.contains(StrVecType {"zeta", "missing", "alpha"}), "missing category in the middle");
+    failures += _check(!layerMap.contains(StrVecType {"mid", "_hidden"}), "private categories are not contained");
+    failures += _check(layerMap.isMember("mid", "p") && !layerMap.isMember("mid", "a"), "isMember on unsorted members");
+    layerMap.set("mid", StrVecType {"s", "r"});
+    failures += _check(!layerMap.isMember("mid", "p") && layerMap.isMember("mid", "r"), "isMember after set()");
+    layerMap.add("mid", "a");
+    layerMap.remove("zeta", "b");
+    failures += _check(layerMap.isMember("mid", "a") && !layerMap.isMember("zeta", "b"), "isMember after add() and remove()");
+    layerMap.remove("zeta", "a");
+    failures += _check(!layerMap.contains(StrVecType {"alpha", "zeta"}), "emptied categories are removed");
+    return failures;
+}
+
+// the unique layers view can be measured and iterated again, each pass visits every layer once
+int _testUniqueLayersView()
+{
+    int failures = 0;
+    LayerMap layerMap(StrMapType {{"beauty", {"diffuse", "specular"}}, {"shading", {"specular", "sss", "diffuse"}}});
+    UniqueLayersView layers = layerMap.uniqueLayersView();
+    const StrVecType expected {"diffuse", "specular", "sss"};
+    failures += _check(!layers.empty() && layers.size() == 3, "unique layers view size");
+    failures += _check(StrVecType(layers.begin(), layers.end()) == expected, "unique layers view after size");
+    failures += _check(StrVecType(layers.begin(), layers.end()) == expected && layerMap.uniqueLayers() == expected,
+        "unique layers view iterated twice");
+    failures += _check(LayerMap().uniqueLayersView().empty(), "unique layers view of an empty map");
+    return failures;
+}
+
+// categorizing in a reused CategorizeResult doesn't allocate once its storage has grown
+int _testWarmCategorizeResult(const LayerCollection& layerCollection)
+{
+    int failures = 0;
+    const StrVecType layerNames {"P", "diffuse_direct", "roto_head", "diffuse_albedo", "puz_custom", "not_configured"};
+    vector<StrView> layerViews(layerNames.begin(), layerNames.end());
+    CategorizeFilter categorizeFilter(StrVecType {"beauty_shading"}, CategorizeFilter::EXCLUDE);
+    CategorizeResult categorized;
+    for (int warmUp = 0; warmUp < 2; warmUp++)
+    {
+        layerCollection.categorizeLayers(spanOf(layerViews), categorizeType::pub, categorized);
+        layerCollection.categorizeLayers(spanOf(layerViews), categorizeType::pub, categorizeFilter, categorized);
+    }
+    // the counts are read before building the check names, which allocate
+    long long allocations = threadAllocations;
+    layerCollection.categorizeLayers(spanOf(layerViews), categorizeType::pub, categorized);
+    bool allocated = threadAllocations != allocations;
+    failures += _check(!allocated, "warm categorization doesn't allocate");
+    allocations = threadAllocations;
+    layerCollection.categorizeLayers(spanOf(layerViews), categorizeType::pub, categorizeFilter, categorized);
+    allocated = threadAllocations != allocations;
+    failures += _check(!allocated, "warm filtered categorization doesn't allocate");
+    failures += _check(categorized.toLayerMap().strMap() ==
+        layerCollection.categorizeLayers(layerNames, categorizeType::pub, categorizeFilter).strMap(),
+        "CategorizeResult matches LayerMap categorization");
+    return failures;
+}
+
+// categoriesOf() and isMember() with and without layer patterns in the configuration
+int _testLayerPatterns()
+{
+    int failures = 0;
+    const ConfigStack channels(StrMapType {{"rgb", {"red", "green", "blue"}}}, false);
+    StrMapType layers {{"diffuse", {"diffuse_direct"}}, {"non_color", {"P"}}};
+    LayerCollection withoutPatterns(ConfigStack(layers, false), channels);
+    failures += _check(withoutPatterns.categoriesOf("diffuse_direct") == StrVecType {"diffuse"}, "categoriesOf without patterns");
+    failures += _check(withoutPatterns.categoriesOf("unknown").empty() && withoutPatterns.categoriesOf("").empty(),
+        "categoriesOf unknown layers without patterns");
+    failures += _check(withoutPatterns.isMember("non_color", "P") && !withoutPatterns.isMember("non_color", "diffuse_direct"),
+        "isMember without patterns");
+    layers["crypto"] = {"crypto_*", "[\xf0-\xff]_*"};
+    LayerCollection withPatterns(ConfigStack(layers, false), channels);
+    failures += _check(withPatterns.categoriesOf("crypto_asset") == StrVecType {"crypto"}, "categoriesOf with patterns");
+    failures += _check(withPatterns.isMember("crypto", "crypto_material") && !withPatterns.isMember("crypto", "diffuse_direct"),
+        "isMember with patterns");
+    failures += _check(withPatterns.isMember("crypto", "\xff_layer"), "character class range ending at \\xff");
+    return failures;
+}
+
+// sorted members of each category of a categorization, incremental updates append the layers they add
+StrMapType _sortedCategorized(const LayerMap& layerMap)
+{
+    StrMapType categorized = layerMap.strMap();
+    for (auto& kvp : categorized)
+    {
+        std::sort(kvp.second.begin(), kvp.second.end());
+    }
+    return categorized;
+}
+
+// updating a categorization with the added and removed layers gives the full categorization of the new layers,
+// and the categories of each layer are found by categoriesOf() without looking at the other categories
+int _testIncrementalCategorization(const LayerCollection& layerCollection)
+{
+    int failures = 0;
+    const StrVecType initial {"P", "diffuse_direct", "beauty_specular", "crypto_asset00", "not_configured"};
+    const StrVecType added {"sss_indirect", "light_group_1"};
+    const StrVecType removed {"diffuse_direct", "crypto_asset00"};
+    StrVecType afterAdd = initial;
+    afterAdd.insert(afterAdd.end(), added.begin(), added.end());
+    StrVecType afterRemove {"P", "beauty_specular", "not_configured", "sss_indirect", "light_group_1"};
+    StrVecType afterReAdd = afterRemove;
+    afterReAdd.insert(afterReAdd.end(), removed.begin(), removed.end());
+    const vector<CategorizeFilter> filters {
+        CategorizeFilter(), CategorizeFilter(StrVecType {"beauty_shading", "light_group"}, CategorizeFilter::ONLY),
+        CategorizeFilter(StrVecType {"beauty_shading"}, CategorizeFilter::EXCLUDE), CategorizeFilter("diffuse | !beauty_shading")};
+    for (size_t index = 0; index < filters.size(); index++)
+    {
+        const CategorizeFilter* filter = index ? &filters[index] : nullptr;
+        auto categorize = [&](const StrVecType& layerNames)
+        {
+            return filter ? layerCollection.categorizeLayers(layerNames, categorizeType::pub, *filter) :
+                layerCollection.categorizeLayers(layerNames, categorizeType::pub);
+        };
+        auto update = [&](LayerMap& categorized, const StrVecType& addedLayers, const StrVecType& removedLayers)
+        {
+            if (filter)
+            {
+                layerCollection.updateCategorizedLayers(categorized, addedLayers, removedLayers, categorizeType::pub, *filter);
+            }
+            else
+            {
+                layerCollection.updateCategorizedLayers(categorized, addedLayers, removedLayers, categorizeType::pub);
+            }
+        };
+        const string filterName = " with filter " + std::to_string(index);
+        LayerMap categorized = categorize(initial);
+        update(categorized, added, StrVecType());
+        failures += _check(_sortedCategorized(categorized) == _sortedCategorized(categorize(afterAdd)), "incremental add" + filterName);
+        update(categorized, StrVecType(), removed);
+        failures += _check(_sortedCategorized(categorized) == _sortedCategorized(categorize(afterRemove)), "incremental remove" + filterName);
+        update(categorized, removed, StrVecType());
+        failures += _check(_sortedCategorized(categorized) == _sortedCategorized(categorize(afterReAdd)), "incremental re-add" + filterName);
+
+        bool covered = true;
+        for (const auto& layerName : afterReAdd)
+        {
+            StrVecType layerCategories = layerCollection.categoriesOf(layerName, categorizeType::pub);
+            layerCategories.emplace_back("all");
+            for (const auto& kvp : categorized.strMap())
+            {
+                bool listed = std::find(layerCategories.begin(), layerCategories.end(), kvp.first) != layerCategories.end();
+                covered &= listed || !categorized.isMember(kvp.first, layerName);
+            }
+        }
+        failures += _check(covered, "categoriesOf lists the categorized categories" + filterName);
+    }
+    return failures;
+}
+
+// subcategories from the merges of the configuration, and membership through them
+int _testCategoryHierarchy()
+{
+    int failures = 0;
+    const ConfigStack channels(StrMapType {{"rgb", {"red", "green", "blue"}}}, false);
+    ConfigMapType layers;
+    layers["crypto_asset"] = {{"crypto_asset", "crypto_asset00"}, {}, true, false};
+    layers["crypto_object"] = {{"crypto_object", "object_*"}, {}, true, false};
+    // merging categories have the merged values too, like the loaded configurations
+    layers["crypto"] = {{"crypto_asset", "crypto_asset00", "crypto_object", "object_*"},
+        {"crypto_asset", "crypto_object"}, true, false};
+    layers["non_color"] = {{"P", "crypto_asset", "crypto_asset00", "crypto_object", "object_*"},
+        {"crypto", "missing"}, true, false};
+    // the same layers, without merging
+    layers["_prefix"] = {{"crypto_asset", "crypto_asset00"}, {}, true, false};
+    LayerCollection collection{ConfigStack(layers), channels};
+    failures += _check(collection.subcategories("crypto") == StrVecType {"crypto_asset", "crypto_object"} &&
+        collection.subcategories("non_color") == StrVecType {"crypto"}, "subcategories are the merged categories");
+    failures += _check(collection.subcategories("_prefix").empty() && !collection.isSubcategory("_prefix", "crypto_asset"),
+        "categories with the same layers are not nested");
+    failures += _check(collection.isSubcategory("non_color", "crypto_asset") && !collection.isSubcategory("crypto_asset", "crypto"),
+        "isSubcategory through the merges");
+    failures += _check(collection.isMember("non_color", "crypto_asset00") && collection.isMember("non_color", "object_x") &&
+        !collection.isMember("crypto", "P"), "isMember through the merges");
+    failures += _check(collection.layers["non_color"] ==
+        StrVecType {"P", "crypto_asset", "crypto_asset00", "crypto_object", "object_*"}, "merged layers in the LayerMap");
+    ConfigMapType cycle;
+    cycle["crypto_asset"] = {{"P"}, {"non_color"}, true, false};
+    LayerCollection cyclic{ConfigStack(layers).push(cycle), channels};
+    failures += _check(cyclic.isSubcategory("crypto_asset", "non_color") && !cyclic.isSubcategory("crypto", "crypto") &&
+        cyclic.isMember("crypto_asset", "P"), "categories merging each other");
+    ConfigMapType removal;
+    removal["non_color"] = {{"crypto_asset00"}, {}, true, true};
+    LayerCollection removed{ConfigStack(layers).push(removal), channels};
+    failures += _check(removed.subcategories("non_color").empty() && removed.isMember("non_color", "crypto_asset") &&
+        !removed.isMember("non_color", "crypto_asset00"), "removals flatten the category");
+    return failures;
+}
+
+// creates an empty temporary directory for the configuration files of a test
+string _makeTestDirectory()
+{
+    char directoryPath[] = "/tmp/LayerTesterXXXXXX";
+    if (mkdtemp(directoryPath) == nullptr)
+    {
+        throw std::runtime_error("can't create a temporary directory");
+    }
+    return directoryPath;
+}
+
+// removes a temporary directory and its files
+void _removeTestDirectory(const string& directoryPath)
+{
+    if (DIR* directory = opendir(directoryPath.c_str()))
+    {
+        while (struct dirent* entry = readdir(directory))
+        {
+            if (entry->d_name[0] != '.')
+            {
+                unlink((directoryPath + "/" + entry->d_name).c_str());
+            }
+        }
+        closedir(directory);
+    }
+    rmdir(directoryPath.c_str());
+}
+
+void _writeTestFile(const string& filePath, const string& text)
+{
+    std::ofstream file(filePath, std::ios::binary | std::ios::trunc);
+    file << text;
+}
+
+string _readTestFile(const string& filePath)
+{
+    std::ifstream file(filePath, std::ios::binary);
+    return string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+// sorted values of each category, sets are sorted when loaded but lists are not
+StrMapType _sortedCategories(StrMapType categories)
+{
+    for (auto& kvp : categories)
+    {
+        std::sort(kvp.second.begin(), kvp.second.end());
+    }
+    return categories;
+}
+
+// a directory of configuration files loads like the single file collapsing them with PyYAML (layer_alchemy._config.collapse).
+// Merges copy the values of the anchored category as they are in its file, later files don't change them
+int _testDirectoryConfig()
+{
+    int failures = 0;
+    string directoryPath = _makeTestDirectory();
+    string layersPath = directoryPath + "/layers";
+    mkdir(layersPath.c_str(), 0700);
+    _writeTestFile(layersPath + "/a.yaml",
+        "depth: !!set &depth\n  ? Z\n"
+        "crypto_asset: !!set &crypto_asset\n  ? crypto_asset\n"
+        "non_color: !!set\n  <<: *depth\n  <<: *crypto_asset\n  ? P\n"
+        "order:\n- a\n");
+    _writeTestFile(layersPath + "/b.yaml",
+        "depth: !!set &depth\n  ? depth_extra\n"
+        "crypto_asset: !!set\n  ? crypto_asset00\n"
+        "matte: !!set\n  <<: *depth\n"
+        "order:\n- b\n");
+    string collapsedPath = directoryPath + "/layers.yaml";
+    _writeTestFile(collapsedPath,
+        "crypto_asset: !!set {? crypto_asset, ? crypto_asset00}\n"
+        "depth: !!set {? Z, ? depth_extra}\n"
+        "matte: !!set {? depth_extra}\n"
+        "non_color: !!set {? P, ? Z, ? crypto_asset}\n"
+        "order: [a, b]\n");
+    try
+    {
+        StrMapType directoryLayers = loadConfigToMap(layersPath);
+        StrMapType collapsedLayers = loadConfigToMap(collapsedPath);
+        failures += _check(_sortedCategories(directoryLayers) == _sortedCategories(collapsedLayers),
+            "directory load matches the collapsed load");
+        failures += _check(directoryLayers["order"] == StrVecType {"a", "b"}, "directory files merged in sorted order");
+        const ConfigStack channels(StrMapType {{"rgb", {"red", "green", "blue"}}}, false);
+        LayerCollection directory{ConfigStack::load(layersPath), channels};
+        LayerCollection collapsed{ConfigStack::load(collapsedPath), channels};
+        StrVecType layerNames {"P", "Z", "depth_extra", "crypto_asset", "crypto_asset00"};
+        failures += _check(directory.categorizeLayers(layerNames, categorizeType::priv).strMap() ==
+            collapsed.categorizeLayers(layerNames, categorizeType::priv).strMap(), "directory and collapsed categorization");
+        failures += _check(!directory.isMember("non_color", "depth_extra") && !directory.isMember("non_color", "crypto_asset00"),
+            "merges keep the values of their file");
+        failures += _check(directory.subcategories("non_color") == StrVecType {"crypto_asset", "depth"} &&
+            collapsed.subcategories("non_color").empty(), "the directory keeps the hierarchy");
+    }
+    catch (const std::exception& error)
+    {
+        failures += _check(false, string("directory load : ") + error.what());
+    }
+    _removeTestDirectory(layersPath);
+    _removeTestDirectory(directoryPath);
+    return failures;
+}
+
+// aliases of nodes still being read are errors of the file, with their position
+int _testConfigErrors()
+{
+    int failures = 0;
+    string directoryPath = _makeTestDirectory();
+    const StrVecType configs {
+        "crypto: !!set &crypto\n  ? crypto00\n  <<: *crypto\n",
+        "crypto: &crypto\n- *crypto\n",
+        "crypto: !!set &crypto\n  <<: !!set &asset {? crypto_asset}\n  <<: *crypto\n"};
+    for (size_t index = 0; index < configs.size(); index++)
+    {
+        string configPath = directoryPath + "/recursive" + std::to_string(index) + ".yaml";
+        _writeTestFile(configPath, configs[index]);
+        bool rejected = false;
+        try
+        {
+            loadConfigToMap(configPath);
+        }
+        catch (const YAML::Exception& error)
+        {
+            rejected = error.mark.line > 0;
+        }
+        failures += _check(rejected, "recursive alias rejected with its position " + std::to_string(index));
+    }
+    _removeTestDirectory(directoryPath);
+    return failures;
+}
+
+bool _sameConfigMaps(const ConfigMapType& configMap, const ConfigMapType& other)
+{
+    return configMap.size() == other.size() && std::equal(configMap.begin(), configMap.end(), other.begin(),
+        [](const ConfigMapType::value_type& first, const ConfigMapType::value_type& second)
+        {
+            return first.first == second.first && first.second.values == second.second.values &&
+                first.second.merges == second.second.merges && first.second.isSet == second.second.isSet &&
+                first.second.isRemoval == second.second.isRemoval;
+        });
+}
+
+// compiled images are used while they match their yaml file, stale, corrupt or older images fall back to the yaml
+int _testConfigCache()
+{
+    int failures = 0;
+    string directoryPath = _makeTestDirectory();
+    string configPath = directoryPath + "/a.yaml";
+    string cachePath = configCachePath(configPath);
+    _writeTestFile(configPath, "depth: !!set &depth\n  ? Z\nnon_color: !!set\n  <<: *depth\n  ? P\norder:\n- a\n");
+    try
+    {
+        const StrMapType parsed = loadConfigToMap(configPath);
+        compileConfigCache(configPath, cachePath);
+        ConfigMapType cached;
+        failures += _check(loadConfigCache(configPath, cachePath, cached) && _sameConfigMaps(cached, _streamConfigFromPath(configPath)),
+            "compiled image loads like the yaml, merges included");
+        // an image of other values for the same yaml file shows which one was loaded
+        ConfigMapType marker;
+        marker["cached"] = {{"image"}, {}, true, false};
+        writeConfigCache(marker, configPath, cachePath);
+        const string image = _readTestFile(cachePath);
+        failures += _check(loadConfigToMap(configPath) == StrMapType {{"cached", {"image"}}}, "up to date image is used");
+
+        string corrupt = image;
+        corrupt[corrupt.size() - 2] ^= 1;
+        _writeTestFile(cachePath, corrupt);
+        failures += _check(loadConfigToMap(configPath) == parsed, "corrupt image falls back to the yaml");
+        _writeTestFile(cachePath, image.substr(0, image.size() / 2));
+        failures += _check(loadConfigToMap(configPath) == parsed, "truncated image falls back to the yaml");
+        _writeTestFile(cachePath, image.substr(0, sizeof(ConfigCacheHeader) - 1));
+        failures += _check(loadConfigToMap(configPath) == parsed, "image without a full header falls back to the yaml");
+        string older = image;
+        uint32_t version = CONFIG_CACHE_VERSION - 1;
+        older.replace(offsetof(ConfigCacheHeader, version), sizeof(version), reinterpret_cast<const char*>(&version), sizeof(version));
+        _writeTestFile(cachePath, older);
+        failures += _check(loadConfigToMap(configPath) == parsed, "image of another version falls back to the yaml");
+
+        _writeTestFile(cachePath, image);
+        _writeTestFile(configPath, "depth: !!set &depth\n  ? Z\nnon_color: !!set\n  <<: *depth\n  ? P\norder:\n- b\n");
+        failures += _check(loadConfigToMap(configPath)["order"] == StrVecType {"b"}, "stale image falls back to the yaml");
+
+        // each file of a directory uses its own image
+        _writeTestFile(directoryPath + "/b.yaml", "order:\n- c\n");
+        writeConfigCache(marker, configPath, cachePath);
+        failures += _check(loadConfigToMap(directoryPath) == StrMapType {{"cached", {"image"}}, {"order", {"c"}}},
+            "directory files use their images");
+        unlink(cachePath.c_str());
+        failures += _check(loadConfigToMap(directoryPath)["order"] == StrVecType {"b", "c"}, "directory without images");
+    }
+    catch (const std::exception& error)
+    {
+        failures += _check(false, string("compiled images : ") + error.what());
+    }
+    _removeTestDirectory(directoryPath);
+    return failures;
+}
+
+// runs the self tests, returns the number of failed checks
+int _runSelfTests()
+{
+    LayerCollection layerCollection;
+    int failures = _testLayerMapContains();
+    failures += _testUniqueLayersView();
+    failures += _testWarmCategorizeResult(layerCollection);
+    failures += _testLayerPatterns();
+    failures += _testIncrementalCategorization(layerCollection);
+    failures += _testCategoryHierarchy();
+    failures += _testDirectoryConfig();
+    failures += _testConfigErrors();
+    failures += _testConfigCache();
+    std::cout << (failures ? redText : "") << failures << " failed checks" << (failures ? endColor : "") << std::endl;
+    return failures;
+}
+
 int main(int argc, const char* argv[])
 {
-    if ((getenv(CHANNEL_ENV_VAR) == NULL) | (getenv(LAYER_ENV_VAR) == NULL))
+    // the embedded configurations are used when the environment variables are not set
+    if (!embeddedConfigEnabled() && ((getenv(CHANNEL_ENV_VAR) == NULL) | (getenv(LAYER_ENV_VAR) == NULL)))
     {
         std::cerr << HEADER << std::endl;
         std::cerr << redText << std::endl << "MISSING ENVIRONMENT VARIABLES" << std::endl;
-        std::cerr << std::endl << "You need to set environment variables pointing to yaml files for :\n"
+        std::cerr << std::endl << "The embedded configurations are disabled by " << EMBEDDED_ENV_VAR
+        << ", you need to set environment variables pointing to yaml files for :\n"
         << std::endl << LAYER_ENV_VAR << std::endl << CHANNEL_ENV_VAR << std::endl << endColor << std::endl;
         return 1;
     }
     ArgumentParser parser(DESCRIPTION);
-    parser.add_argument("--layers", "List of layer names to test", true);
+    parser.add_argument("--layers", "List of layer names to test", false);
+    parser.add_argument("--batch", "File with one list of layer names per line, categorized in parallel", false);
     parser.add_argument("-c", "--categories", "List of categories to filter", false);
+    parser.add_argument("-e", "--expression", "Boolean expression of categories to filter, like '(beauty_shading | light_group) & !albedo'", false);
     parser.add_argument("--topology", "outputs topology", false);
     parser.add_argument("--use_private", "test the private categorization", false);
+    parser.add_argument("--self_test", "run the built in checks and exit, non zero if any failed", false);
 
     try
     {
@@ -64,8 +573,21 @@ int main(int argc, const char* argv[])
     if (parser.is_help())
         return 0;
 
+    if (parser.get<bool>("self_test"))
+    {
+        return _runSelfTests() ? 1 : 0;
+    }
     auto layerNames = parser.getv<std::string>("layers");
+    auto batchFilePath = parser.get<std::string>("batch");
+    if (layerNames.empty() && batchFilePath.empty())
+    {
+        std::cout << HEADER << std::endl;
+        parser.print_help();
+        std::cout << "Required argument not found: --layers or --batch" << std::endl;
+        return 0;
+    }
     auto categories = parser.getv<std::string>("categories");
+    auto expression = parser.get<std::string>("expression");
     bool useTopology = parser.get<bool>("topology");
     bool usePrivate = parser.get<bool>("use_private");
     categorizeType catType = usePrivate ? categorizeType::priv : categorizeType::pub;
@@ -74,7 +596,31 @@ int main(int argc, const char* argv[])
     {
         LayerCollection layerCollection;
 
+        if (!batchFilePath.empty())
+        { // categories only keep the requested categories in batch mode
+            CategorizeFilter categorizeFilter = expression.empty() ?
+                CategorizeFilter(categories, CategorizeFilter::ONLY) : CategorizeFilter(expression);
+            bool filtered = !expression.empty() || !categories.empty();
+            return _runBatch(layerCollection, batchFilePath, filtered ? &categorizeFilter : nullptr, catType);
+        }
         std::cout << std::endl;
+        if (!expression.empty())
+        {
+            LayerMap categorizedLayers = layerCollection.categorizeLayers(layerNames, catType, CategorizeFilter(expression));
+            std::cout << "-----------------------------------------------" << std::endl
+                      << "Layer names : '" + parser.get<std::string>("layers") << "'\n"
+                      << "CategorizeFilter : EXPRESSION" << std::endl
+                      << "Expression : '" << expression << "'";
+            if (useTopology)
+            {
+                _printLayerMapTopology(&layerCollection, categorizedLayers.uniqueLayers());
+            }
+            else
+            {
+                _printLayerMap(categorizedLayers, " ");
+            }
+            return 0;
+        }
         if (categories.size() == 0)
         { // if categories are requested, print all permutations
             if (useTopology)
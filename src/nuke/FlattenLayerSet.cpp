@@ -16,14 +16,7 @@ static const char* const HELP =
     ;
 
 // exclude non color layers, makes no sense for this node
-static const StrVecType categoryExcludeFilterList = {"non_color", "base_color", "albedo"};
-static const CategorizeFilter excludeLayerFilter(categoryExcludeFilterList, CategorizeFilter::modes::EXCLUDE);
-
-static const StrVecType categoryFilterList =
-{
-    "beauty_direct_indirect", "beauty_shading_global", "light_group", "beauty_shading"
-};
-static const CategorizeFilter layerFilter(categoryFilterList, CategorizeFilter::modes::INCLUDE);
+static const CategorizeFilter excludeLayerFilter("!(non_color | base_color | albedo)");
 
 enum operationModes {
     COPY = 0, ADD, REMOVE
@@ -97,9 +90,10 @@ void FlattenLayerSet::_validate(bool for_real)
     copy_info(); // this copies the input info to the output
     ChannelSet inChannels = info_.channels();
     LayerAlchemy::Utilities::validateTargetLayerColorIndex(this, m_targetLayer, 0, 2);
-    if (validateLayerSetKnobUpdate(this, m_lsKnobData, LayerAlchemy::layerCollection, inChannels, excludeLayerFilter))
+    LayerCollectionPtr collection = LayerAlchemy::layerCollection();
+    if (validateLayerSetKnobUpdate(this, m_lsKnobData, *collection, inChannels, excludeLayerFilter))
     {
-        updateLayerSetKnob(this, m_lsKnobData, LayerAlchemy::layerCollection, inChannels, excludeLayerFilter);
+        updateLayerSetKnob(this, m_lsKnobData, *collection, inChannels, excludeLayerFilter);
     }
     set_out_channels(activeChannelSet());
     info_.turn_on(m_targetLayer);
@@ -1,5 +1,7 @@
 #include <math.h>
 #include <algorithm>
+#include <memory>
+#include <mutex>
 
 #include <DDImage/Row.h>
 #include <DDImage/NukeWrapper.h>
@@ -47,14 +49,37 @@ namespace BeautyLayerSetConstants {
         static const StrVecType nonShading = {"beauty_direct_indirect", "beauty_shading_global", "light_group"};
         static const StrVecType global = {"beauty_shading_global", "beauty_direct_indirect"};
     }
-    // frequently used lists of layers 
-    namespace layers
+    // frequently used lists of layers of one configuration
+    struct BeautyLayers
     {
-        static const StrVecType all = LayerAlchemy::layerCollection.layers[categories::all];
-        static const StrVecType shading = LayerAlchemy::layerCollection.layers[categories::shading];
-        static const StrVecType nonShading = LayerAlchemy::layerCollection.layers[categories::nonShading];
-        static const StrVecType global = LayerAlchemy::layerCollection.layers[categories::global];
+        unsigned long generation;
+        StrVecType all;
+        StrVecType shading;
+        StrVecType nonShading;
+        StrVecType global;
     };
+    typedef std::shared_ptr<const BeautyLayers> BeautyLayersPtr;
+
+    // the lists of the current configuration, looked up on first use so loading the plugin doesn't load the
+    // configuration, and again when the configuration watcher publishes a new generation
+    static BeautyLayersPtr layers()
+    {
+        static std::mutex layersMutex;
+        static BeautyLayersPtr cachedLayers;
+        LayerCollectionPtr collection = LayerAlchemy::layerCollection();
+        std::lock_guard<std::mutex> lock(layersMutex);
+        if (!cachedLayers || cachedLayers->generation != collection->generation())
+        {
+            std::shared_ptr<BeautyLayers> beautyLayers = std::make_shared<BeautyLayers>();
+            beautyLayers->generation = collection->generation();
+            beautyLayers->all = collection->layers[categories::all];
+            beautyLayers->shading = collection->layers[categories::shading];
+            beautyLayers->nonShading = collection->layers[categories::nonShading];
+            beautyLayers->global = collection->layers[categories::global];
+            cachedLayers = beautyLayers;
+        }
+        return cachedLayers;
+    }
 }
 
 using namespace DD::Image;
@@ -98,26 +123,28 @@ class GradeBeautyValueMap {
 private:
     map<string, float[3]> m_valueMap;
     map<string, vector<float*>> ptrValueMap;
+    // the layers of the configuration the knobs were made for, a node keeps its knobs after a reload
+    BeautyLayersPtr m_layers;
 public:
     map<Channel, float> multipliers;
     vector<Knob*> m_colorKnobs;
 
     //initializes the layer value mapping and interconnect between of layers
-    GradeBeautyValueMap()
+    GradeBeautyValueMap() : m_layers(BeautyLayerSetConstants::layers())
     {
-        LayerMap layerMapBeautyShading = LayerAlchemy::layerCollection.categorizeLayers(layers::shading, categorizeType::pub);
+        LayerMap layerMapBeautyShading = LayerAlchemy::layerCollection()->categorizeLayers(m_layers->shading, categorizeType::pub);
         m_colorKnobs.reserve(categories::all.size() + 1);
         float* ptrMaster = m_valueMap[MASTER_KNOB_NAME];
         ptrValueMap[MASTER_KNOB_NAME].emplace_back(ptrMaster);
-        for (auto iterLayer = layers::all.begin(); iterLayer != layers::all.end(); iterLayer++)
+        for (auto iterLayer = m_layers->all.begin(); iterLayer != m_layers->all.end(); iterLayer++)
         {
             ptrValueMap[*iterLayer].emplace_back(m_valueMap[*iterLayer]);
             ptrValueMap[*iterLayer].emplace_back(ptrMaster);
         }
 
-        for (auto iterLayer = layers::shading.begin(); iterLayer != layers::shading.end(); iterLayer++)
+        for (auto iterLayer = m_layers->shading.begin(); iterLayer != m_layers->shading.end(); iterLayer++)
         {
-            for (auto iterGlobal = layers::global.begin(); iterGlobal != layers::global.end(); iterGlobal++)
+            for (auto iterGlobal = m_layers->global.begin(); iterGlobal != m_layers->global.end(); iterGlobal++)
             {
                 if (layerMapBeautyShading.contains(*iterGlobal))
                 {
@@ -144,6 +171,12 @@ public:
         return outputVector;
     }
 
+    // the layers of the color knobs
+    const BeautyLayers& layers() const
+    {
+        return *m_layers;
+    }
+
     //returns the pointer specific to this layer
     float* getLayerFloatPointer(const string& knobName) const
     {
@@ -277,9 +310,10 @@ void GradeBeauty::_validate(bool for_real)
     ChannelSet inChannels = info_.channels();
     LayerAlchemy::Utilities::validateTargetLayerColorIndex(this, m_targetLayer, 0, 2);
 
-    if (validateLayerSetKnobUpdate(this, m_lsKnobData, LayerAlchemy::layerCollection, inChannels, CategorizeFilterAllBeauty))
+    LayerCollectionPtr collection = LayerAlchemy::layerCollection();
+    if (validateLayerSetKnobUpdate(this, m_lsKnobData, *collection, inChannels, CategorizeFilterAllBeauty))
     {
-        updateLayerSetKnob(this, m_lsKnobData, LayerAlchemy::layerCollection, inChannels, CategorizeFilterAllBeauty);
+        updateLayerSetKnob(this, m_lsKnobData, *collection, inChannels, CategorizeFilterAllBeauty);
         setKnobVisibility();
         setKnobRanges(m_mathMode, false);
         setKnobDefaultValue(this);
@@ -447,7 +481,8 @@ void GradeBeauty::knobs(Knob_Callback f)
 
     Divider(f, 0); // separates master from the rest
 
-    for (auto iterLayerName = layers::nonShading.begin(); iterLayerName != layers::nonShading.end(); iterLayerName++) 
+    const BeautyLayers& beautyLayers = m_valueMap.layers();
+    for (auto iterLayerName = beautyLayers.nonShading.begin(); iterLayerName != beautyLayers.nonShading.end(); iterLayerName++) 
     {
         Knob* aovKnob = createColorKnob(f, m_valueMap.getLayerFloatPointer(*iterLayerName), *iterLayerName, false);
         Tooltip(f, "applies to this layer or to layers in this layer set");
@@ -459,7 +494,7 @@ void GradeBeauty::knobs(Knob_Callback f)
     BeginClosedGroup(f, "shading_group", "beauty shading layers");
     SetFlags(f, Knob::HIDDEN);
 
-    for (auto iterLayerName = layers::shading.begin(); iterLayerName != layers::shading.end(); iterLayerName++) 
+    for (auto iterLayerName = beautyLayers.shading.begin(); iterLayerName != beautyLayers.shading.end(); iterLayerName++) 
     {
         Knob* aovKnob = createColorKnob(f, m_valueMap.getLayerFloatPointer(*iterLayerName), *iterLayerName, false);
         Tooltip(f, "apply to this layer only");
@@ -526,8 +561,9 @@ void GradeBeauty::setKnobVisibility()
 {
     bool isBeautyShading = LayerAlchemy::LayerSetKnob::getLayerSetKnobEnumString(this) == categories::shading;
     
-    auto layerNames = LayerAlchemy::LayerSet::getLayerNames(m_lsKnobData.m_selectedChannels);
-    LayerMap categorized = LayerAlchemy::layerCollection.categorizeLayers(layerNames, categorizeType::pub);
+    vector<StrView> layerNames;
+    LayerAlchemy::LayerSet::getLayerNameViews(m_lsKnobData.m_selectedChannels, layerNames);
+    LayerMap categorized = LayerAlchemy::layerCollection()->categorizeLayers(spanOf(layerNames), categorizeType::pub);
 
     for (vector<Knob*>::const_iterator iterKnob = m_valueMap.m_colorKnobs.begin(); iterKnob != m_valueMap.m_colorKnobs.end(); iterKnob++) 
     {
@@ -155,8 +155,9 @@ void GradeBeautyLayerSet::_validate(bool for_real) {
     ChannelSet inChannels = info_.channels();
     LayerAlchemy::Utilities::validateTargetLayerColorIndex(this, m_targetLayer, 0, 2);
 
-    if (validateLayerSetKnobUpdate(this, m_lsKnobData, LayerAlchemy::layerCollection, inChannels, CategorizeFilterAllBeauty)) {
-        updateLayerSetKnob(this, m_lsKnobData, LayerAlchemy::layerCollection, inChannels, CategorizeFilterAllBeauty);
+    LayerCollectionPtr collection = LayerAlchemy::layerCollection();
+    if (validateLayerSetKnobUpdate(this, m_lsKnobData, *collection, inChannels, CategorizeFilterAllBeauty)) {
+        updateLayerSetKnob(this, m_lsKnobData, *collection, inChannels, CategorizeFilterAllBeauty);
     }
     set_out_channels(activeChannelSet());
     info_.turn_on(m_targetLayer);
@@ -79,8 +79,9 @@ void GradeLayerSet::_validate(bool for_real)
     info_.black_outside(!changeZero);
     ChannelSet inChannels = info_.channels();
 
-    if (validateLayerSetKnobUpdate(this, m_lsKnobData, LayerAlchemy::layerCollection, inChannels)) {
-        updateLayerSetKnob(this, m_lsKnobData, LayerAlchemy::layerCollection, inChannels);
+    LayerCollectionPtr collection = LayerAlchemy::layerCollection();
+    if (validateLayerSetKnobUpdate(this, m_lsKnobData, *collection, inChannels)) {
+        updateLayerSetKnob(this, m_lsKnobData, *collection, inChannels);
     }
     set_out_channels(activeChannelSet());
 }
@@ -1,28 +1,98 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <unordered_set>
+
 #include "LayerSet.h"
+#include "LayerSetWatcher.h"
 
 namespace LayerAlchemy {
+
+// the configuration loaded once per process, either directly or through a configuration watcher
+class SharedLayerCollection {
+public:
+    SharedLayerCollection()
+    {
+        auto start = std::chrono::steady_clock::now();
+        const char* layerConfigPath = getenv(LAYER_ENV_VAR);
+        const char* channelConfigPath = getenv(CHANNEL_ENV_VAR);
+        if (LayerCollectionWatcher::enabled() && layerConfigPath && channelConfigPath) {
+            m_watcher.reset(new LayerCollectionWatcher(layerConfigPath, channelConfigPath, true));
+            m_watcher->start();
+        } else {
+            m_collection = std::make_shared<const LayerCollection>();
+        }
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        m_loadTime = elapsed.count();
+    }
+    LayerCollectionPtr get() const
+    {
+        return m_watcher ? m_watcher->snapshot() : m_collection;
+    }
+    double loadTime() const
+    {
+        return m_loadTime;
+    }
+private:
+    LayerCollectionPtr m_collection;
+    std::unique_ptr<LayerCollectionWatcher> m_watcher;
+    double m_loadTime;
+};
+
+static std::atomic<const SharedLayerCollection*> sharedLayerCollectionLoaded(nullptr);
+
+static const SharedLayerCollection& _sharedLayerCollection()
+{
+    // initialized on first use, C++11 guarantees only one thread constructs it
+    static const SharedLayerCollection sharedLayerCollection;
+    sharedLayerCollectionLoaded.store(&sharedLayerCollection, std::memory_order_release);
+    return sharedLayerCollection;
+}
+
+LayerCollectionPtr layerCollection()
+{
+    return _sharedLayerCollection().get();
+}
+
+double layerCollectionLoadTime()
+{
+    const SharedLayerCollection* loaded = sharedLayerCollectionLoaded.load(std::memory_order_acquire);
+    return loaded ? loaded->loadTime() : 0.0;
+}
+
 namespace LayerSet {
 
 StrVecType getLayerNames(const DD::Image::ChannelSet& inChannels)
 {
-    DD::Image::ChannelSet selectedChannels;
     StrVecType layerNames;
+    std::unordered_set<StrView> seenLayers;
 
     foreach(z, inChannels) {
-        string layer = DD::Image::getLayerName(z);
-        bool contains = (find(begin(layerNames), end(layerNames), layer)) != layerNames.end();
-
-        if (!contains) {
-            layerNames.emplace_back(layer);
+        // Nuke owns the layer names for the whole session
+        StrView layer = DD::Image::getLayerName(z);
+        if (seenLayers.insert(layer).second) {
+            layerNames.emplace_back(layer.str());
         }
     }
     return layerNames;
 }
 
+void getLayerNameViews(const DD::Image::ChannelSet& inChannels, vector<StrView>& layerNames)
+{
+    layerNames.clear();
+    foreach(z, inChannels) {
+        StrView layer = DD::Image::getLayerName(z);
+        if (layerNames.empty() || layerNames.back() != layer) {
+            layerNames.push_back(layer);
+        }
+    }
+}
+
 ChannelSetMapType _layerMaptoChannelMap(const LayerMap& layerMap, const DD::Image::ChannelSet& inChannels)
 {
     ChannelSetMapType channelSetLayerMap;
-    for (auto& kvp : layerMap.strMap) {
+    for (auto& kvp : layerMap.strMap()) {
         foreach (channel, inChannels) {
             string layerName = getLayerName(channel);
             if (layerMap.isMember(kvp.first, layerName)) {
@@ -33,19 +103,59 @@ ChannelSetMapType _layerMaptoChannelMap(const LayerMap& layerMap, const DD::Imag
     return channelSetLayerMap;
 }
 
+void _updateChannelMap(ChannelSetMapType& channelSetLayerMap, const LayerCollection& collection, const LayerMap& layerMap, const categorizeType& catType, const DD::Image::ChannelSet& previousChannels, const DD::Image::ChannelSet& inChannels)
+{
+    DD::Image::ChannelSet removedChannels = previousChannels;
+    removedChannels -= inChannels;
+    DD::Image::ChannelSet addedChannels = inChannels;
+    addedChannels -= previousChannels;
+    // a channel is only in "all" and in the categories of its layer, consecutive channels share their layer
+    string layerName;
+    StrVecType categoryNames;
+    auto layerCategories = [&](DD::Image::Channel channel) -> const StrVecType& {
+        StrView channelLayer = DD::Image::getLayerName(channel);
+        if (categoryNames.empty() || channelLayer != StrView(layerName)) {
+            layerName = channelLayer.str();
+            categoryNames = collection.categoriesOf(channelLayer, catType);
+            categoryNames.emplace_back("all");
+        }
+        return categoryNames;
+    };
+    foreach (channel, removedChannels) {
+        for (const auto& categoryName : layerCategories(channel)) {
+            auto categoryChannels = channelSetLayerMap.find(categoryName);
+            if (categoryChannels != channelSetLayerMap.end()) {
+                categoryChannels->second -= channel;
+                if (categoryChannels->second.empty()) {
+                    channelSetLayerMap.erase(categoryChannels);
+                }
+            }
+        }
+    }
+    // layers are categorized independently, the channels of the other layers keep their categories
+    foreach (channel, addedChannels) {
+        for (const auto& categoryName : layerCategories(channel)) {
+            if (layerMap.isMember(categoryName, layerName)) {
+                channelSetLayerMap[categoryName].insert(channel);
+            }
+        }
+    }
+}
+
 ChannelSetMapType categorizeChannelSet(const LayerCollection& collection, const DD::Image::ChannelSet& inChannels)
 {
     StrVecType inLayers = LayerSet::getLayerNames(inChannels);
-    LayerMap layerMap = collection.categorizeLayers(inLayers, categorizeType::pub);
-    return _layerMaptoChannelMap(layerMap, inChannels);
+    LayerMapPtr layerMap = collection.cachedCategorizeLayers(inLayers, categorizeType::pub);
+    return _layerMaptoChannelMap(*layerMap, inChannels);
 }
 
 ChannelSetMapType categorizeChannelSet(const LayerCollection& collection, const DD::Image::ChannelSet& inChannels, const CategorizeFilter& categorizeFilter)
 {
     StrVecType inLayers = LayerSet::getLayerNames(inChannels);
-    LayerMap layerMap = collection.categorizeLayers(inLayers, categorizeType::pub, categorizeFilter);
-    layerMap.strMap.erase("all"); // not useful for Nuke when CategorizeFilter is used
-    return _layerMaptoChannelMap(layerMap, inChannels);
+    LayerMapPtr layerMap = collection.cachedCategorizeLayers(inLayers, categorizeType::pub, categorizeFilter);
+    ChannelSetMapType channelSetLayerMap = _layerMaptoChannelMap(*layerMap, inChannels);
+    channelSetLayerMap.erase("all"); // not useful for Nuke when CategorizeFilter is used
+    return channelSetLayerMap;
 }
 
 StrVecType getCategories(const ChannelSetMapType& channelSetLayerMap)
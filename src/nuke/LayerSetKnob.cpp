@@ -60,24 +60,100 @@ void _updateLayerSetKnobEnum(DD::Image::Op* t_op, LayerSetKnobData& layerSetKnob
     layerSetKnob->set_value(selectedIndex);
 
     layerSetKnobData.m_selectedChannels.clear();
-    layerSetKnobData.m_selectedChannels += channelSetLayerMap[layerSetName];
+    // find, not operator[], the map is kept between updates and must not gain empty categories
+    auto selectedChannels = channelSetLayerMap.find(layerSetName);
+    if (selectedChannels != channelSetLayerMap.end()) {
+        layerSetKnobData.m_selectedChannels += selectedChannels->second;
+    }
     layerSetKnobData.categoryName = layerSetName;
     layerSetKnobData.m_allChannels = inChannels;
     //printf("_updateLayerSetKnobEnum categorized %s\n", layerSetName.c_str());
 }
-void updateLayerSetKnob(DD::Image::Op* t_op, LayerSetKnobData& layerSetKnobData, LayerCollection& collection, DD::Image::ChannelSet& inChannels)
+ChannelSetMapType& _categorizeLayerSetKnobChannels(LayerSetKnobData& layerSetKnobData, const LayerCollection& collection, const DD::Image::ChannelSet& inChannels, const CategorizeFilter* categorizeFilter)
+{
+    bool sameCollection = layerSetKnobData.m_collection == &collection &&
+        layerSetKnobData.m_collectionGeneration == collection.generation();
+    ChannelSetMapType& layerChannels = layerSetKnobData.m_layerChannels;
+    if (!sameCollection || layerSetKnobData.m_categorizedChannels.empty())
+    {
+        StrVecType inLayers = LayerSet::getLayerNames(inChannels);
+        LayerMapPtr layerMap = categorizeFilter ?
+            collection.cachedCategorizeLayers(inLayers, categorizeType::pub, *categorizeFilter) :
+            collection.cachedCategorizeLayers(inLayers, categorizeType::pub);
+        layerSetKnobData.m_categorized = *layerMap;
+        layerSetKnobData.m_channelSetLayerMap = LayerSet::_layerMaptoChannelMap(*layerMap, inChannels);
+        layerChannels.clear();
+        foreach (channel, inChannels)
+        {
+            layerChannels[DD::Image::getLayerName(channel)].insert(channel);
+        }
+    }
+    else
+    {
+        // upstream edits usually add or remove a few channels, only the layers they add or remove are categorized
+        DD::Image::ChannelSet removedChannels = layerSetKnobData.m_categorizedChannels;
+        removedChannels -= inChannels;
+        DD::Image::ChannelSet addedChannels = inChannels;
+        addedChannels -= layerSetKnobData.m_categorizedChannels;
+        StrVecType addedLayers, removedLayers;
+        foreach (channel, removedChannels)
+        {
+            auto channels = layerChannels.find(DD::Image::getLayerName(channel));
+            if (channels == layerChannels.end())
+            {
+                continue;
+            }
+            channels->second -= channel;
+            if (channels->second.empty())
+            {
+                removedLayers.emplace_back(channels->first);
+                layerChannels.erase(channels);
+            }
+        }
+        foreach (channel, addedChannels)
+        {
+            string layerName = DD::Image::getLayerName(channel);
+            DD::Image::ChannelSet& channels = layerChannels[layerName];
+            if (channels.empty())
+            {
+                addedLayers.emplace_back(layerName);
+            }
+            channels.insert(channel);
+        }
+        if (categorizeFilter)
+        {
+            collection.updateCategorizedLayers(layerSetKnobData.m_categorized, addedLayers, removedLayers, categorizeType::pub, *categorizeFilter);
+        }
+        else
+        {
+            collection.updateCategorizedLayers(layerSetKnobData.m_categorized, addedLayers, removedLayers, categorizeType::pub);
+        }
+        LayerSet::_updateChannelMap(layerSetKnobData.m_channelSetLayerMap, collection, layerSetKnobData.m_categorized,
+                                    categorizeType::pub, layerSetKnobData.m_categorizedChannels, inChannels);
+    }
+    if (categorizeFilter)
+    {
+        layerSetKnobData.m_channelSetLayerMap.erase("all"); // not useful for Nuke when CategorizeFilter is used
+    }
+    layerSetKnobData.m_collection = &collection;
+    layerSetKnobData.m_collectionGeneration = collection.generation();
+    layerSetKnobData.m_categorizedChannels = inChannels;
+    return layerSetKnobData.m_channelSetLayerMap;
+}
+
+void updateLayerSetKnob(DD::Image::Op* t_op, LayerSetKnobData& layerSetKnobData, const LayerCollection& collection, DD::Image::ChannelSet& inChannels)
 {
     if (!inChannels.empty())
     {
-        ChannelSetMapType channelSetLayerMap = LayerAlchemy::LayerSet::categorizeChannelSet(collection, inChannels);
+        ChannelSetMapType& channelSetLayerMap = _categorizeLayerSetKnobChannels(layerSetKnobData, collection, inChannels, nullptr);
         _updateLayerSetKnobEnum(t_op, layerSetKnobData, channelSetLayerMap, inChannels);
     }
 }
-void updateLayerSetKnob(DD::Image::Op* t_op, LayerSetKnobData& layerSetKnobData, LayerCollection& collection, DD::Image::ChannelSet& inChannels, const CategorizeFilter& categorizeFilter)
+void updateLayerSetKnob(DD::Image::Op* t_op, LayerSetKnobData& layerSetKnobData, const LayerCollection& collection, DD::Image::ChannelSet& inChannels, const CategorizeFilter& categorizeFilter)
 {
     if (!inChannels.empty())
     {
-        ChannelSetMapType channelSetLayerMap = LayerAlchemy::LayerSet::categorizeChannelSet(collection, inChannels, categorizeFilter);
+        ChannelSetMapType& channelSetLayerMap = _categorizeLayerSetKnobChannels(layerSetKnobData, collection, inChannels, &categorizeFilter);
         _updateLayerSetKnobEnum(t_op, layerSetKnobData, channelSetLayerMap, inChannels);
     }
 }
@@ -136,25 +212,53 @@ bool _categorizedValidateLayerSetKnobUpdate(DD::Image::Op* t_op, const LayerMap&
 
 }
 
-bool validateLayerSetKnobUpdate(DD::Image::Op* t_op, const LayerSetKnobData& layerSetKnobData, LayerCollection& layerCollection, const DD::Image::ChannelSet& inChannels)
+bool _categorizedValidateLayerSetKnobUpdate(DD::Image::Op* t_op, const CategorizeResult& categorized, const string& currentLayerSetName)
+{
+    if (categorized.empty())
+    {
+        t_op->error("can't find any relevant layer set for this node");
+        return false;
+    }
+    else if (currentLayerSetName == "")
+    {
+        return true;
+    }
+    else if (!categorized.contains(currentLayerSetName))
+    {
+        t_op->error("input is missing the '%s' layer set", currentLayerSetName.c_str());
+        return false;
+    }
+    else
+    {
+        return true;
+    }
+
+}
+
+bool validateLayerSetKnobUpdate(DD::Image::Op* t_op, const LayerSetKnobData& layerSetKnobData, const LayerCollection& layerCollection, const DD::Image::ChannelSet& inChannels)
 {
     string currentLayerSetName = getLayerSetKnobEnumString(t_op);
     if (!_basicValidateLayerSetKnobUpdate(t_op, layerSetKnobData, inChannels)) {
         return false;
     }
-    StrVecType inLayers = LayerSet::getLayerNames(inChannels);
-    LayerMap categorized = layerCollection.categorizeLayers(LayerSet::getLayerNames(inChannels), categorizeType::pub);
+    // reused by every validation on this thread, so validating doesn't allocate or copy layer names
+    static thread_local vector<StrView> inLayers;
+    static thread_local CategorizeResult categorized;
+    LayerSet::getLayerNameViews(inChannels, inLayers);
+    layerCollection.categorizeLayers(spanOf(inLayers), categorizeType::pub, categorized);
     return _categorizedValidateLayerSetKnobUpdate(t_op, categorized, currentLayerSetName);
 }
 
-bool validateLayerSetKnobUpdate(DD::Image::Op* t_op, const LayerSetKnobData& layerSetKnobData, LayerCollection& layerCollection, const DD::Image::ChannelSet& inChannels, const CategorizeFilter& categorizeFilter)
+bool validateLayerSetKnobUpdate(DD::Image::Op* t_op, const LayerSetKnobData& layerSetKnobData, const LayerCollection& layerCollection, const DD::Image::ChannelSet& inChannels, const CategorizeFilter& categorizeFilter)
 {
     string currentLayerSetName = getLayerSetKnobEnumString(t_op);
     if (!_basicValidateLayerSetKnobUpdate(t_op, layerSetKnobData, inChannels)) {
         return false;
     }
-    StrVecType inLayers = LayerSet::getLayerNames(inChannels);
-    LayerMap categorized = layerCollection.categorizeLayers(inLayers, categorizeType::pub, categorizeFilter);
+    static thread_local vector<StrView> inLayers;
+    static thread_local CategorizeResult categorized;
+    LayerSet::getLayerNameViews(inChannels, inLayers);
+    layerCollection.categorizeLayers(spanOf(inLayers), categorizeType::pub, categorizeFilter, categorized);
     return _categorizedValidateLayerSetKnobUpdate(t_op, categorized, currentLayerSetName);
 }
 } //  LayerSetKnob
@@ -53,8 +53,9 @@ void MultiplyLayerSet::_validate(bool for_real)
 {
     copy_info(); // this copies the input info to the output
     ChannelSet inChannels = info_.channels();
-    if (validateLayerSetKnobUpdate(this, m_lsKnobData, LayerAlchemy::layerCollection, inChannels)) {
-        updateLayerSetKnob(this, m_lsKnobData, LayerAlchemy::layerCollection, inChannels);
+    LayerCollectionPtr collection = LayerAlchemy::layerCollection();
+    if (validateLayerSetKnobUpdate(this, m_lsKnobData, *collection, inChannels)) {
+        updateLayerSetKnob(this, m_lsKnobData, *collection, inChannels);
     }
     set_out_channels(activeChannelSet());
 }
@@ -0,0 +1,579 @@
+/*
+ * Python extension module wrapping LayerCollection, results are native dicts and lists.
+ * The GIL is released while layers are categorized, so threaded tools run calls in parallel.
+ */
+
+#include <Python.h>
+
+#include "LayerSetCore.h"
+#include "LayerSetEmbedded.h"
+#include "LayerSetParallel.h"
+
+#if PY_MAJOR_VERSION >= 3
+#define PyString_Check PyUnicode_Check
+#define PyString_FromStringAndSize PyUnicode_FromStringAndSize
+#endif
+
+// converts a Python str to a string, returns false with a TypeError set otherwise
+static bool _toString(PyObject* object, string& value) {
+#if PY_MAJOR_VERSION >= 3
+    if (PyUnicode_Check(object)) {
+        Py_ssize_t size;
+        const char* characters = PyUnicode_AsUTF8AndSize(object, &size);
+        if (!characters) {
+            return false;
+        }
+        value.assign(characters, size);
+        return true;
+    }
+#else
+    if (PyString_Check(object)) {
+        value.assign(PyString_AS_STRING(object), PyString_GET_SIZE(object));
+        return true;
+    }
+#endif
+    PyErr_SetString(PyExc_TypeError, "expected a str");
+    return false;
+}
+
+// converts a Python sequence of str to a StrVecType, a single str is a list of one
+static bool _toStrVec(PyObject* object, StrVecType& values) {
+    string value;
+    if (PyString_Check(object)) {
+        if (!_toString(object, value)) {
+            return false;
+        }
+        values.push_back(value);
+        return true;
+    }
+    PyObject* sequence = PySequence_Fast(object, "expected a sequence of str");
+    if (!sequence) {
+        return false;
+    }
+    Py_ssize_t size = PySequence_Fast_GET_SIZE(sequence);
+    values.reserve(values.size() + size);
+    for (Py_ssize_t index = 0; index < size; index++) {
+        if (!_toString(PySequence_Fast_GET_ITEM(sequence, index), value)) {
+            Py_DECREF(sequence);
+            return false;
+        }
+        values.push_back(value);
+    }
+    Py_DECREF(sequence);
+    return true;
+}
+
+static PyObject* _fromStrView(const StrView& value) {
+    return PyString_FromStringAndSize(value.data(), value.size());
+}
+
+static PyObject* _fromStrVec(const StrVecType& values) {
+    PyObject* list = PyList_New(values.size());
+    if (!list) {
+        return nullptr;
+    }
+    for (size_t index = 0; index < values.size(); index++) {
+        PyObject* item = _fromStrView(values[index]);
+        if (!item) {
+            Py_DECREF(list);
+            return nullptr;
+        }
+        PyList_SET_ITEM(list, index, item);
+    }
+    return list;
+}
+
+// {category : [layers]}, the dict version of a LayerMap
+static PyObject* _fromStrMap(const StrMapType& strMap) {
+    PyObject* dict = PyDict_New();
+    if (!dict) {
+        return nullptr;
+    }
+    for (const auto& kvp : strMap) {
+        PyObject* members = _fromStrVec(kvp.second);
+        if (!members || PyDict_SetItemString(dict, kvp.first.c_str(), members) < 0) {
+            Py_XDECREF(members);
+            Py_DECREF(dict);
+            return nullptr;
+        }
+        Py_DECREF(members);
+    }
+    return dict;
+}
+
+static PyObject* _fromCategorizeResult(const CategorizeResult& result) {
+    PyObject* dict = PyDict_New();
+    if (!dict) {
+        return nullptr;
+    }
+    for (size_t index = 0; index < result.size(); index++) {
+        CategorizeResult::MemberRange members = result.members(index);
+        PyObject* key = _fromStrView(result.category(index));
+        PyObject* list = PyList_New(members.end() - members.begin());
+        bool failed = !key || !list;
+        for (Py_ssize_t position = 0; !failed && position < members.end() - members.begin(); position++) {
+            PyObject* item = _fromStrView(members.begin()[position]);
+            failed = !item;
+            if (item) {
+                PyList_SET_ITEM(list, position, item);
+            }
+        }
+        if (failed || PyDict_SetItem(dict, key, list) < 0) {
+            Py_XDECREF(key);
+            Py_XDECREF(list);
+            Py_DECREF(dict);
+            return nullptr;
+        }
+        Py_DECREF(key);
+        Py_DECREF(list);
+    }
+    return dict;
+}
+
+/*
+ * CategorizeFilter
+ */
+
+typedef struct {
+    PyObject_HEAD
+    CategorizeFilter* filter;
+} PyCategorizeFilter;
+
+static PyTypeObject PyCategorizeFilterType = {PyVarObject_HEAD_INIT(NULL, 0)};
+
+static int PyCategorizeFilter_init(PyCategorizeFilter* self, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = {"categories", "mode", nullptr};
+    PyObject* categoriesObject;
+    int mode = CategorizeFilter::INCLUDE;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|i", const_cast<char**>(keywords), &categoriesObject, &mode)) {
+        return -1;
+    }
+    if (mode < CategorizeFilter::INCLUDE || mode > CategorizeFilter::EXPRESSION) {
+        PyErr_SetString(PyExc_ValueError, "mode must be INCLUDE, EXCLUDE, ONLY or EXPRESSION");
+        return -1;
+    }
+    CategorizeFilter* filter = nullptr;
+    if (mode == CategorizeFilter::EXPRESSION) {
+        string expression;
+        if (!PyString_Check(categoriesObject)) {
+            PyErr_SetString(PyExc_TypeError, "EXPRESSION filters expect a str expression");
+            return -1;
+        }
+        if (!_toString(categoriesObject, expression)) {
+            return -1;
+        }
+        try {
+            filter = new CategorizeFilter(expression);
+        } catch (const std::invalid_argument& error) {
+            PyErr_SetString(PyExc_ValueError, error.what());
+            return -1;
+        }
+    } else {
+        StrVecType categories;
+        if (!_toStrVec(categoriesObject, categories)) {
+            return -1;
+        }
+        filter = new CategorizeFilter(categories, mode);
+    }
+    delete self->filter;
+    self->filter = filter;
+    return 0;
+}
+
+static void PyCategorizeFilter_dealloc(PyCategorizeFilter* self) {
+    delete self->filter;
+    Py_TYPE(self)->tp_free(reinterpret_cast<PyObject*>(self));
+}
+
+static PyObject* PyCategorizeFilter_getCategories(PyCategorizeFilter* self, void*) {
+    return _fromStrVec(self->filter ? self->filter->categories : StrVecType());
+}
+
+static PyObject* PyCategorizeFilter_getExpression(PyCategorizeFilter* self, void*) {
+    return _fromStrView(self->filter ? self->filter->expression : string());
+}
+
+static PyObject* PyCategorizeFilter_getMode(PyCategorizeFilter* self, void*) {
+    return PyLong_FromLong(self->filter ? self->filter->filterMode : CategorizeFilter::INCLUDE);
+}
+
+static PyGetSetDef PyCategorizeFilter_getset[] = {
+    {const_cast<char*>("categories"), reinterpret_cast<getter>(PyCategorizeFilter_getCategories), nullptr,
+     const_cast<char*>("category names of the filter"), nullptr},
+    {const_cast<char*>("mode"), reinterpret_cast<getter>(PyCategorizeFilter_getMode), nullptr,
+     const_cast<char*>("INCLUDE, EXCLUDE, ONLY or EXPRESSION"), nullptr},
+    {const_cast<char*>("expression"), reinterpret_cast<getter>(PyCategorizeFilter_getExpression), nullptr,
+     const_cast<char*>("boolean expression of category names of EXPRESSION filters"), nullptr},
+    {nullptr}
+};
+
+// the CategorizeFilter of an optional Python argument, nullptr for None. Returns false with an error set
+static bool _toCategorizeFilter(PyObject* object, const CategorizeFilter*& filter) {
+    filter = nullptr;
+    if (!object || object == Py_None) {
+        return true;
+    }
+    if (!PyObject_TypeCheck(object, &PyCategorizeFilterType)) {
+        PyErr_SetString(PyExc_TypeError, "expected a CategorizeFilter");
+        return false;
+    }
+    filter = reinterpret_cast<PyCategorizeFilter*>(object)->filter;
+    if (!filter) {
+        PyErr_SetString(PyExc_ValueError, "CategorizeFilter is not initialized");
+        return false;
+    }
+    return true;
+}
+
+/*
+ * LayerCollection
+ */
+
+typedef struct {
+    PyObject_HEAD
+    LayerCollection* collection;
+} PyLayerCollection;
+
+static PyTypeObject PyLayerCollectionType = {PyVarObject_HEAD_INIT(NULL, 0)};
+
+static int PyLayerCollection_init(PyLayerCollection* self, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = {"layerConfig", "channelConfig", nullptr};
+    PyObject* layerConfigObject = nullptr;
+    PyObject* channelConfigObject = nullptr;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|OO", const_cast<char**>(keywords), &layerConfigObject, &channelConfigObject)) {
+        return -1;
+    }
+    bool useEnvironment = (!layerConfigObject || layerConfigObject == Py_None) &&
+                          (!channelConfigObject || channelConfigObject == Py_None);
+    StrVecType layerConfigPaths, channelConfigPaths;
+    if (!useEnvironment) {
+        if (!layerConfigObject || layerConfigObject == Py_None || !channelConfigObject || channelConfigObject == Py_None) {
+            PyErr_SetString(PyExc_TypeError, "both layerConfig and channelConfig are needed");
+            return -1;
+        }
+        if (!_toStrVec(layerConfigObject, layerConfigPaths) || !_toStrVec(channelConfigObject, channelConfigPaths)) {
+            return -1;
+        }
+    } else if (!embeddedConfigEnabled() && (!getenv(LAYER_ENV_VAR) || !getenv(CHANNEL_ENV_VAR))) {
+        PyErr_Format(PyExc_RuntimeError, "%s and %s need to be set when %s is 0", LAYER_ENV_VAR, CHANNEL_ENV_VAR,
+                     EMBEDDED_ENV_VAR);
+        return -1;
+    }
+    LayerCollection* collection = nullptr;
+    string errorMessage;
+    bool invalidArgument = false;
+    Py_BEGIN_ALLOW_THREADS
+    try {
+        if (useEnvironment) {
+            collection = new LayerCollection();
+        } else if (layerConfigPaths.size() == 1 && channelConfigPaths.size() == 1) { // files or directories
+            collection = new LayerCollection(layerConfigPaths[0], channelConfigPaths[0]);
+        } else {
+            collection = new LayerCollection(layerConfigPaths, channelConfigPaths);
+        }
+    } catch (const std::invalid_argument& error) {
+        errorMessage = error.what();
+        invalidArgument = true;
+    } catch (const std::exception& error) {
+        errorMessage = error.what();
+    }
+    Py_END_ALLOW_THREADS
+    if (!collection) {
+        PyErr_SetString(invalidArgument ? PyExc_ValueError : PyExc_RuntimeError, errorMessage.c_str());
+        return -1;
+    }
+    delete self->collection;
+    self->collection = collection;
+    return 0;
+}
+
+static void PyLayerCollection_dealloc(PyLayerCollection* self) {
+    delete self->collection;
+    Py_TYPE(self)->tp_free(reinterpret_cast<PyObject*>(self));
+}
+
+static bool _checkCollection(PyLayerCollection* self) {
+    if (!self->collection) {
+        PyErr_SetString(PyExc_RuntimeError, "LayerCollection is not initialized");
+        return false;
+    }
+    return true;
+}
+
+static PyObject* PyLayerCollection_categorizeLayers(PyLayerCollection* self, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = {"layers", "filter", "private", nullptr};
+    PyObject* layersObject;
+    PyObject* filterObject = nullptr;
+    PyObject* privateObject = nullptr;
+    if (!_checkCollection(self) ||
+        !PyArg_ParseTupleAndKeywords(args, kwargs, "O|OO", const_cast<char**>(keywords), &layersObject, &filterObject, &privateObject)) {
+        return nullptr;
+    }
+    StrVecType layers;
+    const CategorizeFilter* filter;
+    int usePrivate = privateObject ? PyObject_IsTrue(privateObject) : 0;
+    if (usePrivate < 0 || !_toStrVec(layersObject, layers) || !_toCategorizeFilter(filterObject, filter)) {
+        return nullptr;
+    }
+    categorizeType catType = usePrivate ? categorizeType::priv : categorizeType::pub;
+    // one reusable result per thread, categorization doesn't allocate once it is warm
+    static thread_local CategorizeResult result;
+    bool failed = false;
+    string errorMessage;
+    Py_BEGIN_ALLOW_THREADS
+    try {
+        if (filter) {
+            self->collection->categorizeLayers(layers, catType, *filter, result);
+        } else {
+            self->collection->categorizeLayers(layers, catType, result);
+        }
+    } catch (const std::exception& error) {
+        failed = true;
+        errorMessage = error.what();
+    }
+    Py_END_ALLOW_THREADS
+    if (failed) {
+        PyErr_SetString(PyExc_RuntimeError, errorMessage.c_str());
+        return nullptr;
+    }
+    return _fromCategorizeResult(result);
+}
+
+static PyObject* PyLayerCollection_categorizeBatch(PyLayerCollection* self, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = {"layerLists", "filter", "private", nullptr};
+    PyObject* listsObject;
+    PyObject* filterObject = nullptr;
+    PyObject* privateObject = nullptr;
+    if (!_checkCollection(self) ||
+        !PyArg_ParseTupleAndKeywords(args, kwargs, "O|OO", const_cast<char**>(keywords), &listsObject, &filterObject, &privateObject)) {
+        return nullptr;
+    }
+    const CategorizeFilter* filter;
+    int usePrivate = privateObject ? PyObject_IsTrue(privateObject) : 0;
+    if (usePrivate < 0 || !_toCategorizeFilter(filterObject, filter)) {
+        return nullptr;
+    }
+    PyObject* sequence = PySequence_Fast(listsObject, "expected a sequence of layer lists");
+    if (!sequence) {
+        return nullptr;
+    }
+    vector<StrVecType> layerLists(PySequence_Fast_GET_SIZE(sequence));
+    for (size_t index = 0; index < layerLists.size(); index++) {
+        if (!_toStrVec(PySequence_Fast_GET_ITEM(sequence, index), layerLists[index])) {
+            Py_DECREF(sequence);
+            return nullptr;
+        }
+    }
+    Py_DECREF(sequence);
+    categorizeType catType = usePrivate ? categorizeType::priv : categorizeType::pub;
+    // CategorizeResults are converted to dicts directly, going through LayerMaps would cost more than categorizing.
+    // They are kept per calling thread, so repeated batches don't allocate them again
+    static thread_local vector<std::unique_ptr<CategorizeResult> > results;
+    while (results.size() < layerLists.size()) {
+        results.emplace_back(new CategorizeResult());
+    }
+    const LayerCollection& collection = *self->collection;
+    bool failed = false;
+    string errorMessage;
+    Py_BEGIN_ALLOW_THREADS
+    try {
+        parallelFor(layerLists.size(), [&](size_t index) {
+            if (filter) {
+                collection.categorizeLayers(layerLists[index], catType, *filter, *results[index]);
+            } else {
+                collection.categorizeLayers(layerLists[index], catType, *results[index]);
+            }
+        }, std::thread::hardware_concurrency());
+    } catch (const std::exception& error) {
+        failed = true;
+        errorMessage = error.what();
+    }
+    Py_END_ALLOW_THREADS
+    if (failed) {
+        PyErr_SetString(PyExc_RuntimeError, errorMessage.c_str());
+        return nullptr;
+    }
+    PyObject* list = PyList_New(layerLists.size());
+    if (!list) {
+        return nullptr;
+    }
+    for (size_t index = 0; index < layerLists.size(); index++) {
+        PyObject* dict = _fromCategorizeResult(*results[index]);
+        if (!dict) {
+            Py_DECREF(list);
+            return nullptr;
+        }
+        PyList_SET_ITEM(list, index, dict);
+    }
+    return list;
+}
+
+static PyObject* PyLayerCollection_topology(PyLayerCollection* self, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = {"layers", "style", nullptr};
+    PyObject* layersObject;
+    const char* styleName = "lexical";
+    if (!_checkCollection(self) ||
+        !PyArg_ParseTupleAndKeywords(args, kwargs, "O|s", const_cast<char**>(keywords), &layersObject, &styleName)) {
+        return nullptr;
+    }
+    topologyStyle style;
+    if (string(styleName) == "lexical") {
+        style = topologyStyle::lexical;
+    } else if (string(styleName) == "exr") {
+        style = topologyStyle::exr;
+    } else {
+        PyErr_SetString(PyExc_ValueError, "style must be 'lexical' or 'exr'");
+        return nullptr;
+    }
+    StrVecType layers;
+    if (!_toStrVec(layersObject, layers)) {
+        return nullptr;
+    }
+    LayerMap channelMapping;
+    Py_BEGIN_ALLOW_THREADS
+    channelMapping = self->collection->topology(layers, style);
+    Py_END_ALLOW_THREADS
+    return _fromStrMap(channelMapping.strMap());
+}
+
+static PyObject* PyLayerCollection_categoriesOf(PyLayerCollection* self, PyObject* args) {
+    PyObject* layerObject;
+    string layerName;
+    if (!_checkCollection(self) || !PyArg_ParseTuple(args, "O", &layerObject) || !_toString(layerObject, layerName)) {
+        return nullptr;
+    }
+    return _fromStrVec(self->collection->categoriesOf(layerName));
+}
+
+static PyObject* PyLayerCollection_subcategories(PyLayerCollection* self, PyObject* args) {
+    PyObject* categoryObject;
+    string categoryName;
+    if (!_checkCollection(self) || !PyArg_ParseTuple(args, "O", &categoryObject) || !_toString(categoryObject, categoryName)) {
+        return nullptr;
+    }
+    return _fromStrVec(self->collection->subcategories(categoryName));
+}
+
+static PyObject* PyLayerCollection_isMember(PyLayerCollection* self, PyObject* args) {
+    PyObject* categoryObject;
+    PyObject* layerObject;
+    string categoryName, layerName;
+    if (!_checkCollection(self) || !PyArg_ParseTuple(args, "OO", &categoryObject, &layerObject) ||
+        !_toString(categoryObject, categoryName) || !_toString(layerObject, layerName)) {
+        return nullptr;
+    }
+    return PyBool_FromLong(self->collection->isMember(categoryName, layerName));
+}
+
+static PyObject* PyLayerCollection_categories(PyLayerCollection* self, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = {"private", nullptr};
+    PyObject* privateObject = nullptr;
+    if (!_checkCollection(self) ||
+        !PyArg_ParseTupleAndKeywords(args, kwargs, "|O", const_cast<char**>(keywords), &privateObject)) {
+        return nullptr;
+    }
+    int usePrivate = privateObject ? PyObject_IsTrue(privateObject) : 0;
+    if (usePrivate < 0) {
+        return nullptr;
+    }
+    return _fromStrVec(self->collection->layers.categoriesByType(usePrivate ? categorizeType::priv : categorizeType::pub));
+}
+
+static PyObject* PyLayerCollection_layers(PyLayerCollection* self, void*) {
+    return _checkCollection(self) ? _fromStrMap(self->collection->layers.strMap()) : nullptr;
+}
+
+static PyObject* PyLayerCollection_channels(PyLayerCollection* self, void*) {
+    return _checkCollection(self) ? _fromStrMap(self->collection->channels.strMap()) : nullptr;
+}
+
+static PyMethodDef PyLayerCollection_methods[] = {
+    {"categorizeLayers", reinterpret_cast<PyCFunction>(PyLayerCollection_categorizeLayers), METH_VARARGS | METH_KEYWORDS,
+     "categorizeLayers(layers, filter=None, private=False) -> {category: [layers]}"},
+    {"categorizeBatch", reinterpret_cast<PyCFunction>(PyLayerCollection_categorizeBatch), METH_VARARGS | METH_KEYWORDS,
+     "categorizeBatch(layerLists, filter=None, private=False) -> [{category: [layers]}], categorized on all cores"},
+    {"topology", reinterpret_cast<PyCFunction>(PyLayerCollection_topology), METH_VARARGS | METH_KEYWORDS,
+     "topology(layers, style='lexical') -> {layer: [channels]}, style is 'lexical' or 'exr'"},
+    {"categoriesOf", reinterpret_cast<PyCFunction>(PyLayerCollection_categoriesOf), METH_VARARGS,
+     "categoriesOf(layer) -> [categories] of a layer name in the layer configuration"},
+    {"subcategories", reinterpret_cast<PyCFunction>(PyLayerCollection_subcategories), METH_VARARGS,
+     "subcategories(category) -> [categories] merged by a category"},
+    {"isMember", reinterpret_cast<PyCFunction>(PyLayerCollection_isMember), METH_VARARGS,
+     "isMember(category, layer) -> True if the layer is in the category, merged layers included"},
+    {"categories", reinterpret_cast<PyCFunction>(PyLayerCollection_categories), METH_VARARGS | METH_KEYWORDS,
+     "categories(private=False) -> [categories] of the layer configuration"},
+    {nullptr}
+};
+
+static PyGetSetDef PyLayerCollection_getset[] = {
+    {const_cast<char*>("layers"), reinterpret_cast<getter>(PyLayerCollection_layers), nullptr,
+     const_cast<char*>("layer configuration, {category: [layers]}"), nullptr},
+    {const_cast<char*>("channels"), reinterpret_cast<getter>(PyLayerCollection_channels), nullptr,
+     const_cast<char*>("channel configuration, {category: [channels]}"), nullptr},
+    {nullptr}
+};
+
+/*
+ * module
+ */
+
+static const char* MODULE_DOC = "LayerAlchemy layer categorization, see LayerSetCore.h";
+
+#if PY_MAJOR_VERSION >= 3
+static PyModuleDef layerSetCoreModule = {PyModuleDef_HEAD_INIT, "LayerSetCore", MODULE_DOC, -1, nullptr};
+#endif
+
+static PyObject* _initModule() {
+    PyCategorizeFilterType.tp_name = "LayerSetCore.CategorizeFilter";
+    PyCategorizeFilterType.tp_basicsize = sizeof(PyCategorizeFilter);
+    PyCategorizeFilterType.tp_flags = Py_TPFLAGS_DEFAULT;
+    PyCategorizeFilterType.tp_doc = "CategorizeFilter(categories, mode=INCLUDE), or CategorizeFilter(expression, EXPRESSION)";
+    PyCategorizeFilterType.tp_new = PyType_GenericNew;
+    PyCategorizeFilterType.tp_init = reinterpret_cast<initproc>(PyCategorizeFilter_init);
+    PyCategorizeFilterType.tp_dealloc = reinterpret_cast<destructor>(PyCategorizeFilter_dealloc);
+    PyCategorizeFilterType.tp_getset = PyCategorizeFilter_getset;
+
+    PyLayerCollectionType.tp_name = "LayerSetCore.LayerCollection";
+    PyLayerCollectionType.tp_basicsize = sizeof(PyLayerCollection);
+    PyLayerCollectionType.tp_flags = Py_TPFLAGS_DEFAULT;
+    PyLayerCollectionType.tp_doc =
+        "LayerCollection(layerConfig=None, channelConfig=None)\n"
+        "configurations are files, directories or lists of them, the embedded configurations and the environment\n"
+        "variables are used by default";
+    PyLayerCollectionType.tp_new = PyType_GenericNew;
+    PyLayerCollectionType.tp_init = reinterpret_cast<initproc>(PyLayerCollection_init);
+    PyLayerCollectionType.tp_dealloc = reinterpret_cast<destructor>(PyLayerCollection_dealloc);
+    PyLayerCollectionType.tp_methods = PyLayerCollection_methods;
+    PyLayerCollectionType.tp_getset = PyLayerCollection_getset;
+
+    if (PyType_Ready(&PyCategorizeFilterType) < 0 || PyType_Ready(&PyLayerCollectionType) < 0) {
+        return nullptr;
+    }
+#if PY_MAJOR_VERSION >= 3
+    PyObject* module = PyModule_Create(&layerSetCoreModule);
+#else
+    PyObject* module = Py_InitModule3("LayerSetCore", nullptr, MODULE_DOC);
+#endif
+    if (!module) {
+        return nullptr;
+    }
+    Py_INCREF(&PyCategorizeFilterType);
+    PyModule_AddObject(module, "CategorizeFilter", reinterpret_cast<PyObject*>(&PyCategorizeFilterType));
+    Py_INCREF(&PyLayerCollectionType);
+    PyModule_AddObject(module, "LayerCollection", reinterpret_cast<PyObject*>(&PyLayerCollectionType));
+    PyModule_AddIntConstant(module, "INCLUDE", CategorizeFilter::INCLUDE);
+    PyModule_AddIntConstant(module, "EXCLUDE", CategorizeFilter::EXCLUDE);
+    PyModule_AddIntConstant(module, "ONLY", CategorizeFilter::ONLY);
+    PyModule_AddIntConstant(module, "EXPRESSION", CategorizeFilter::EXPRESSION);
+    return module;
+}
+
+#if PY_MAJOR_VERSION >= 3
+PyMODINIT_FUNC PyInit_LayerSetCore() {
+    return _initModule();
+}
+#else
+PyMODINIT_FUNC initLayerSetCore() {
+    _initModule();
+}
+#endif